@@ -16,6 +16,11 @@
 #include "JArrayList.h"
 #include "EelVmVariable.h"
 #include "fieldsurround/FieldSurroundProcessor.h"
+#include "fixedrate/EdgeResampler.h"
+#include "chainpreview/ChainResponse.h"
+#include "pipeline/Pipeline.h"
+#include "pipeline/TwoStageRunner.h"
+#include "convolver/PartitionedConvolver.h"
 
 extern "C" {
 #include "../EELStdOutExtension.h"
@@ -63,6 +68,259 @@ inline int32_t clamp24FromFloat(float sample) {
     return static_cast<int32_t>(scaled > 0.0f ? scaled + 0.5f : scaled - 0.5f);
 }
 
+inline jshort int16FromFloat(float sample) {
+    constexpr float kScale = 32768.0f;
+    if (sample <= -1.0f) {
+        return static_cast<jshort>(INT16_MIN);
+    }
+    if (sample >= 1.0f) {
+        return static_cast<jshort>(INT16_MAX);
+    }
+    const float scaled = sample * kScale;
+    const int rounded = static_cast<int>(scaled > 0.0f ? scaled + 0.5f : scaled - 0.5f);
+    return static_cast<jshort>(std::clamp(rounded, static_cast<int>(INT16_MIN), static_cast<int>(INT16_MAX)));
+}
+
+inline jint int32FromFloat(float sample) {
+    constexpr double kScale = 2147483648.0;
+    if (sample <= -1.0f) {
+        return INT32_MIN;
+    }
+    if (sample >= 1.0f) {
+        return INT32_MAX;
+    }
+    const double scaled = static_cast<double>(sample) * kScale;
+    return static_cast<jint>(scaled > 0.0 ? scaled + 0.5 : scaled - 0.5);
+}
+
+// 8.24 fixed point in the low bits of an int32
+inline jint int8U24FromFloat(float sample) {
+    constexpr float kInt24Scale = 8388608.0f;
+    constexpr float kInt24Max = 8388607.0f;
+    constexpr float kInt24Min = -8388608.0f;
+    const float scaled = std::clamp(sample * kInt24Scale, kInt24Min, kInt24Max);
+    return static_cast<jint>(scaled > 0.0f ? scaled + 0.5f : scaled - 0.5f);
+}
+
+inline bool needsFloatChain(JamesDspWrapper* wrapper) {
+    auto* fieldSurround = wrapper->fieldSurround;
+    auto* edgeResampler = wrapper->edgeResampler;
+    return (fieldSurround != nullptr && fieldSurround->isEnabled()) ||
+           (edgeResampler != nullptr && edgeResampler->isResampling()) ||
+           wrapper->twoStage != nullptr ||
+           wrapper->partitionedConvolver != nullptr;
+}
+
+// Stages of the float chain, each processes a planar block in place
+struct FieldSurroundStage : pipeline::Stage {
+    fieldsurround::FieldSurroundProcessor* processor;
+    void run(float* const* channels, uint32_t frames) const { processor->process(channels, frames); }
+};
+
+// Runs ahead of the libjamesdsp chain, the wrapper cannot reach Convolver1D's place inside it.
+struct ConvolverStage : pipeline::Stage {
+    convolver::PartitionedConvolver* convolver;
+    void run(float* const* channels, uint32_t frames) const { convolver->process(channels, frames); }
+};
+
+struct CoreStage : pipeline::Stage {
+    JamesDSPLib* dsp;
+    void run(float* const* channels, uint32_t frames) const {
+        dsp->processFloatDeinterleaved(dsp, channels[0], channels[1], channels[0], channels[1], frames);
+    }
+};
+
+// Optional stages in front of the libjamesdsp chain, one bit each in the active-stage mask
+enum ChainStage : uint32_t {
+    kChainFieldSurround = 1u << 0,
+    kChainConvolver = 1u << 1,
+    kChainStageCount = 2
+};
+
+template <uint32_t Mask>
+struct ChainVariant {
+    static void run(JamesDspWrapper* wrapper, JamesDSPLib* dsp, float* const* channels, uint32_t frames) {
+        const FieldSurroundStage surround{{}, wrapper->fieldSurround};
+        const ConvolverStage convolver{{}, wrapper->partitionedConvolver};
+        const CoreStage core{{}, dsp};
+        if constexpr ((Mask & kChainFieldSurround) != 0 && (Mask & kChainConvolver) != 0) {
+            (surround >> convolver >> core).run(channels, frames);
+        } else if constexpr ((Mask & kChainFieldSurround) != 0) {
+            (surround >> core).run(channels, frames);
+        } else if constexpr ((Mask & kChainConvolver) != 0) {
+            (convolver >> core).run(channels, frames);
+        } else {
+            core.run(channels, frames);
+        }
+    }
+};
+
+using ChainKernel = void (*)(JamesDspWrapper*, JamesDSPLib*, float* const*, uint32_t);
+using ChainKernels = pipeline::KernelTable<ChainKernel, ChainVariant, 1u << kChainStageCount>;
+
+inline uint32_t activeStageMask(JamesDspWrapper* wrapper) {
+    auto* fieldSurround = wrapper->fieldSurround;
+    return ((fieldSurround != nullptr && fieldSurround->isEnabled()) ? kChainFieldSurround : 0u) |
+           (wrapper->partitionedConvolver != nullptr ? kChainConvolver : 0u);
+}
+
+// Calls process(offset, count) over consecutive sub-blocks of at most blockFrames frames, so a large call
+// runs every stage on one cache-sized sub-block before moving on to the next
+template <typename Process>
+inline void forEachBlock(uint32_t blockFrames, uint32_t frames, Process&& process) {
+    for (uint32_t offset = 0; offset < frames; offset += blockFrames) {
+        process(offset, std::min(blockFrames, frames - offset));
+    }
+}
+
+// Same with the wrapper's current block size, read once per call
+template <typename Process>
+inline void forEachBlock(JamesDspWrapper* wrapper, uint32_t frames, Process&& process) {
+    forEachBlock(wrapper->blockFrames.load(std::memory_order_relaxed), frames, process);
+}
+
+// Edge conversion into the planar buffer, the chain kernel and the conversion back, one sub-block at a time
+template <typename Load, typename Store>
+inline void runPlanarBlocks(JamesDspWrapper* wrapper, JamesDSPLib* dsp, ChainKernel kernel, uint32_t frames,
+                            Load&& load, Store&& store) {
+    // One load sizes the buffer and the sub-blocks, setProcessingBlockFrames may change it in between
+    const uint32_t blockFrames = wrapper->blockFrames.load(std::memory_order_relaxed);
+    float* const* channels = wrapper->planarBuffer.reserve(std::min(frames, blockFrames));
+    forEachBlock(blockFrames, frames, [&](uint32_t offset, uint32_t count) {
+        const size_t base = static_cast<size_t>(offset) * 2;
+        for (uint32_t i = 0; i < count; ++i) {
+            channels[0][i] = load(base + static_cast<size_t>(i) * 2);
+            channels[1][i] = load(base + static_cast<size_t>(i) * 2 + 1);
+        }
+        kernel(wrapper, dsp, channels, count);
+        for (uint32_t i = 0; i < count; ++i) {
+            store(base + static_cast<size_t>(i) * 2, channels[0][i]);
+            store(base + static_cast<size_t>(i) * 2 + 1, channels[1][i]);
+        }
+    });
+}
+
+// Set on the pipeline runner's thread, Liveprog output printed there is queued instead of calling into Java
+static thread_local bool onPipelineThread = false;
+// Lines kept while no process call picks them up
+constexpr size_t kMaxQueuedLiveprogLines = 256;
+
+// Hands the Liveprog output queued on the runner's thread to the callback, on the calling thread
+inline void deliverLiveprogOutput(JNIEnv* env, JamesDspWrapper* wrapper) {
+    if (!wrapper->liveprogOutputPending.load(std::memory_order_acquire)) {
+        return;
+    }
+    std::vector<std::string> lines;
+    {
+        std::lock_guard<std::mutex> lock(wrapper->liveprogOutputMutex);
+        lines.swap(wrapper->liveprogOutput);
+        wrapper->liveprogOutputPending.store(false, std::memory_order_relaxed);
+    }
+    for (const auto& line : lines) {
+        jstring text = env->NewStringUTF(line.c_str());
+        env->CallVoidMethod(wrapper->callbackInterface, wrapper->callbackOnLiveprogOutput, text);
+        env->DeleteLocalRef(text);
+    }
+}
+
+// Back segment of the pipelined chain, the libjamesdsp chain on the runner's thread
+inline void runCoreSegment(void* context, float* const* channels, uint32_t frames) {
+    auto* wrapper = static_cast<JamesDspWrapper*>(context);
+    onPipelineThread = true;
+    const CoreStage core{{}, cast(wrapper->dsp)};
+    forEachBlock(wrapper, frames, [&core, channels](uint32_t offset, uint32_t count) {
+        float* const block[2] = {channels[0] + offset, channels[1] + offset};
+        core.run(block, count);
+    });
+}
+
+// Pipelined counterpart of runPlanarBlocks: the edge conversion, FieldSurround and the wrapper's convolver run
+// here as the front segment, the libjamesdsp chain runs on the runner's thread and the output is the block
+// before this one
+template <typename Load, typename Store>
+inline void runTwoStageBlocks(JamesDspWrapper* wrapper, pipeline::TwoStageRunner* runner, uint32_t frames,
+                              Load&& load, Store&& store) {
+    float* const* slot = runner->beginBlock(frames);
+    const uint32_t mask = activeStageMask(wrapper);
+    forEachBlock(wrapper, frames, [&](uint32_t offset, uint32_t count) {
+        const size_t base = static_cast<size_t>(offset) * 2;
+        float* const block[2] = {slot[0] + offset, slot[1] + offset};
+        for (uint32_t i = 0; i < count; ++i) {
+            block[0][i] = load(base + static_cast<size_t>(i) * 2);
+            block[1][i] = load(base + static_cast<size_t>(i) * 2 + 1);
+        }
+        if ((mask & kChainFieldSurround) != 0) {
+            FieldSurroundStage{{}, wrapper->fieldSurround}.run(block, count);
+        }
+        if ((mask & kChainConvolver) != 0) {
+            ConvolverStage{{}, wrapper->partitionedConvolver}.run(block, count);
+        }
+    });
+    float* const* done = runner->endBlock();
+    for (uint32_t i = 0; i < frames; ++i) {
+        store(static_cast<size_t>(i) * 2, done[0][i]);
+        store(static_cast<size_t>(i) * 2 + 1, done[1][i]);
+    }
+}
+
+// Runs the float chain on frames interleaved stereo frames. load(i) returns input sample i as float and
+// store(i, sample) writes output sample i, so the format conversion at the edges also does the
+// (de)interleaving and the chain itself only sees planar buffers. In fixed-rate mode the chain runs at the
+// internal rate between the edge converters, which work on interleaved frames. With pipelined processing on,
+// the output lags by one block and Liveprog output of the runner's thread is delivered here on env's thread.
+// Caller holds tempBufferMutex.
+template <typename Load, typename Store>
+inline void processFloatChain(JNIEnv* env, JamesDspWrapper* wrapper, JamesDSPLib* dsp, uint32_t frames,
+                              Load&& load, Store&& store) {
+    const ChainKernel kernel = ChainKernels::select(activeStageMask(wrapper));
+    auto* edgeResampler = wrapper->edgeResampler;
+    auto* twoStage = wrapper->twoStage;
+    if (edgeResampler == nullptr || !edgeResampler->isResampling()) {
+        if (twoStage != nullptr) {
+            runTwoStageBlocks(wrapper, twoStage, frames, load, store);
+            deliverLiveprogOutput(env, wrapper);
+        } else {
+            runPlanarBlocks(wrapper, dsp, kernel, frames, load, store);
+        }
+        return;
+    }
+
+    // The internal block size follows the converter and changes from call to call, the pipeline would
+    // flush on every block. Fixed-rate mode therefore runs the chain in one piece.
+    if (twoStage != nullptr) {
+        twoStage->flush();
+        deliverLiveprogOutput(env, wrapper);
+    }
+
+    const size_t sampleCount = static_cast<size_t>(frames) * 2;
+    auto* temp = getTempBuffer(wrapper, sampleCount);
+    if (temp == nullptr) {
+        return;
+    }
+    for (size_t i = 0; i < sampleCount; ++i) {
+        temp[i] = load(i);
+    }
+    edgeResampler->process(temp, frames, [wrapper, dsp, kernel](float* x, uint32_t n) {
+        runPlanarBlocks(wrapper, dsp, kernel, n,
+            [x](size_t i) { return x[i]; },
+            [x](size_t i, float sample) { x[i] = sample; });
+    });
+    for (size_t i = 0; i < sampleCount; ++i) {
+        store(i, temp[i]);
+    }
+}
+
+// Swaps the wrapper's convolver between two blocks. The old one joins its workers after the lock is released.
+inline void replacePartitionedConvolver(JamesDspWrapper* wrapper, convolver::PartitionedConvolver* next) {
+    convolver::PartitionedConvolver* previous;
+    {
+        std::lock_guard<std::mutex> lock(wrapper->tempBufferMutex);
+        previous = wrapper->partitionedConvolver;
+        wrapper->partitionedConvolver = next;
+    }
+    delete previous;
+}
+
 #define RETURN_IF_NULL(name, retval) \
     if(name == nullptr)      \
         return retval;
@@ -174,6 +432,9 @@ Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_alloc(JNIEnv *e
     if (fieldSurround != nullptr) {
         fieldSurround->setSamplingRate(static_cast<uint32_t>(_dsp->fs));
     }
+    self->edgeResampler = new fixedrate::EdgeResampler();
+    self->edgeResampler->configure(0, static_cast<uint32_t>(_dsp->fs));
+    self->chainResponse = new chainpreview::ChainResponse();
 
     LOGD("JamesDspWrapper::ctor: memory allocated at %lx", (long)self);
     return (long)self;
@@ -188,11 +449,20 @@ Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_free(JNIEnv *en
 
     setStdOutHandler(nullptr, nullptr);
 
+    // The runner's thread may still be inside the chain
+    delete wrapper->twoStage;
+    wrapper->twoStage = nullptr;
+    delete wrapper->partitionedConvolver;
+    wrapper->partitionedConvolver = nullptr;
     JamesDSPFree(dsp);
     free(dsp);
     wrapper->dsp = nullptr;
     delete wrapper->fieldSurround;
     wrapper->fieldSurround = nullptr;
+    delete wrapper->edgeResampler;
+    wrapper->edgeResampler = nullptr;
+    delete wrapper->chainResponse;
+    wrapper->chainResponse = nullptr;
 
     JamesDSPGlobalMemoryDeallocation();
 
@@ -245,13 +515,167 @@ Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_setSamplingRate
                                                                                  jboolean force_refresh)
 {
     DECLARE_DSP_V
+    auto* edgeResampler = wrapper->edgeResampler;
+    if (edgeResampler != nullptr && edgeResampler->isEnabled()) {
+        // The chain keeps running at the internal rate, only the edge converters follow the device
+        std::lock_guard<std::mutex> lock(wrapper->tempBufferMutex);
+        edgeResampler->setDeviceRate(static_cast<uint32_t>(sample_rate));
+        LOGD("JamesDspWrapper::setSamplingRate: device rate %d Hz, edge latency %u frames",
+             static_cast<int>(sample_rate), edgeResampler->getLatencyFrames());
+        return;
+    }
+    if (edgeResampler != nullptr) {
+        edgeResampler->setDeviceRate(static_cast<uint32_t>(sample_rate));
+    }
     JamesDSPSetSampleRate(dsp, sample_rate, force_refresh);
     auto* fieldSurround = wrapper->fieldSurround;
     if (fieldSurround != nullptr) {
+        std::lock_guard<std::mutex> lock(wrapper->tempBufferMutex);
         fieldSurround->setSamplingRate((uint32_t)sample_rate);
     }
 }
 
+extern "C"
+JNIEXPORT jboolean JNICALL
+Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_setFixedRateProcessing(JNIEnv *env,
+                                                                                        jobject obj,
+                                                                                        jlong self,
+                                                                                        jint internal_rate)
+{
+    DECLARE_DSP_B
+    auto* edgeResampler = wrapper->edgeResampler;
+    RETURN_IF_NULL(edgeResampler, false)
+
+    const uint32_t internalRate = internal_rate > 0 ? static_cast<uint32_t>(internal_rate) : 0;
+    if (internalRate == edgeResampler->getInternalRate()) {
+        return true;
+    }
+
+    // The chain is redesigned once for its new rate, later device rate changes leave it alone
+    const uint32_t chainRate = internalRate > 0 ? internalRate : edgeResampler->getDeviceRate();
+    JamesDSPSetSampleRate(dsp, static_cast<float>(chainRate), 1);
+    auto* fieldSurround = wrapper->fieldSurround;
+
+    std::lock_guard<std::mutex> lock(wrapper->tempBufferMutex);
+    if (wrapper->twoStage != nullptr) {
+        wrapper->twoStage->flush();
+    }
+    if (fieldSurround != nullptr) {
+        fieldSurround->setSamplingRate(chainRate);
+    }
+    if (!edgeResampler->configure(internalRate, edgeResampler->getDeviceRate())) {
+        LOGE("JamesDspWrapper::setFixedRateProcessing: failed to create edge converters");
+        JamesDSPSetSampleRate(dsp, static_cast<float>(edgeResampler->getDeviceRate()), 1);
+        if (fieldSurround != nullptr) {
+            fieldSurround->setSamplingRate(edgeResampler->getDeviceRate());
+        }
+        return false;
+    }
+    LOGD("JamesDspWrapper::setFixedRateProcessing: internal rate %u Hz, edge latency %u frames",
+         internalRate, edgeResampler->getLatencyFrames());
+    return true;
+}
+
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_setProcessingBlockFrames(JNIEnv *env,
+                                                                                         jobject obj,
+                                                                                         jlong self,
+                                                                                         jint frames)
+{
+    DECLARE_WRAPPER_B
+    // Whole cache lines of planar floats, so every sub-block starts aligned
+    const uint32_t clamped = std::clamp<uint32_t>(frames > 0 ? static_cast<uint32_t>(frames) : kDefaultBlockFrames,
+                                                  kMinBlockFrames, kMaxBlockFrames);
+    wrapper->blockFrames.store(clamped & ~15u, std::memory_order_relaxed);
+    return true;
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_setPipelinedProcessing(JNIEnv *env,
+                                                                                       jobject obj,
+                                                                                       jlong self,
+                                                                                       jboolean enable)
+{
+    DECLARE_DSP_B
+    std::lock_guard<std::mutex> lock(wrapper->tempBufferMutex);
+    if (enable == (wrapper->twoStage != nullptr)) {
+        return true;
+    }
+    if (enable) {
+        wrapper->twoStage = new pipeline::TwoStageRunner(runCoreSegment, wrapper);
+    } else {
+        delete wrapper->twoStage;
+        wrapper->twoStage = nullptr;
+        deliverLiveprogOutput(env, wrapper);
+    }
+    LOGD("JamesDspWrapper::setPipelinedProcessing: %s", enable ? "on" : "off");
+    return true;
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_setPartitionedConvolution(JNIEnv *env,
+                                                                                          jobject obj,
+                                                                                          jlong self,
+                                                                                          jboolean enable)
+{
+    DECLARE_WRAPPER_B
+    // Takes effect with the next setConvolver call, which loads the impulse response into the selected convolver
+    wrapper->partitionedConvolution.store(enable);
+    if (!enable) {
+        replacePartitionedConvolver(wrapper, nullptr);
+    }
+    LOGD("JamesDspWrapper::setPartitionedConvolution: %s", enable ? "on" : "off");
+    return true;
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_setConvolverHalfPrecision(JNIEnv *env,
+                                                                                          jobject obj,
+                                                                                          jlong self,
+                                                                                          jboolean enable)
+{
+    DECLARE_WRAPPER_B
+    // Like the mode itself, applies from the next impulse response the partitioned convolver loads
+    wrapper->halfPrecisionSpectra.store(enable);
+    LOGD("JamesDspWrapper::setConvolverHalfPrecision: %s", enable ? "on" : "off");
+    return true;
+}
+
+extern "C" JNIEXPORT jboolean JNICALL
+Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_getConvolverLoad(JNIEnv *env,
+                                                                                 jobject obj,
+                                                                                 jlong self,
+                                                                                 jfloatArray loadObj)
+{
+    DECLARE_DSP_B
+    if (env->GetArrayLength(loadObj) < 2) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(wrapper->tempBufferMutex);
+    auto* partitioned = wrapper->partitionedConvolver;
+    RETURN_IF_NULL(partitioned, false)
+
+    // Share of real time spent on the audio thread and on the tail workers together
+    const float nsPerFrame = 1.0e9f / std::max(1.0f, static_cast<float>(dsp->fs));
+    const jfloat load[2] = {
+        partitioned->callerNsPerFrame() / nsPerFrame,
+        partitioned->workerNsPerFrame() / nsPerFrame
+    };
+    env->SetFloatArrayRegion(loadObj, 0, 2, load);
+    return true;
+}
+
+extern "C" JNIEXPORT jint JNICALL
+Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_getConvolverDeadlineMisses(JNIEnv *env,
+                                                                                           jobject obj,
+                                                                                           jlong self)
+{
+    DECLARE_WRAPPER(0)
+    std::lock_guard<std::mutex> lock(wrapper->tempBufferMutex);
+    auto* partitioned = wrapper->partitionedConvolver;
+    return partitioned != nullptr ? static_cast<jint>(partitioned->deadlineMisses()) : 0;
+}
 
 extern "C" JNIEXPORT jboolean JNICALL
 Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_isHandleValid(JNIEnv *env, jobject obj, jlong self)
@@ -292,40 +716,21 @@ Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_processInt16(JN
     auto input = env->GetShortArrayElements(inputObj, nullptr);
     auto output = env->GetShortArrayElements(outputObj, nullptr);
 
-    auto* fieldSurround = wrapper->fieldSurround;
-    const bool applyFieldSurround = fieldSurround != nullptr && fieldSurround->isEnabled();
+    const bool applyFloatChain = needsFloatChain(wrapper);
     const uint32_t frames = static_cast<uint32_t>(inputLength / 2);
 
-    if (applyFieldSurround) {
+    if (applyFloatChain) {
         std::lock_guard<std::mutex> lock(wrapper->tempBufferMutex);
-        auto* temp = getTempBuffer(wrapper, static_cast<size_t>(inputLength));
-        if (temp == nullptr) {
-            env->ReleaseShortArrayElements(inputObj, input, JNI_ABORT);
-            env->ReleaseShortArrayElements(outputObj, output, JNI_ABORT);
-            return;
-        }
-        for (jsize i = 0; i < inputLength; ++i) {
-            temp[i] = static_cast<float>(input[safeOffset + i]) / 32768.0f;
-        }
-        fieldSurround->process(temp, frames);
-        dsp->processFloatMultiplexd(dsp, temp, temp, frames);
-
-        constexpr float kScale = 32768.0f;
-        for (jsize i = 0; i < inputLength; ++i) {
-            const float sample = temp[i];
-            if (sample <= -1.0f) {
-                output[i] = static_cast<jshort>(INT16_MIN);
-            } else if (sample >= 1.0f) {
-                output[i] = static_cast<jshort>(INT16_MAX);
-            } else {
-                const float scaled = sample * kScale;
-                const int rounded = static_cast<int>(scaled > 0.0f ? scaled + 0.5f : scaled - 0.5f);
-                const int clamped = std::clamp(rounded, static_cast<int>(INT16_MIN), static_cast<int>(INT16_MAX));
-                output[i] = static_cast<jshort>(clamped);
-            }
-        }
+        const jshort* source = input + safeOffset;
+        processFloatChain(env, wrapper, dsp, frames,
+            [source](size_t i) { return static_cast<float>(source[i]) / 32768.0f; },
+            [output](size_t i, float sample) { output[i] = int16FromFloat(sample); });
     } else {
-        dsp->processInt16Multiplexd(dsp, input + safeOffset, output, frames);
+        const jshort* source = input + safeOffset;
+        forEachBlock(wrapper, frames, [dsp, source, output](uint32_t offset, uint32_t count) {
+            const size_t base = static_cast<size_t>(offset) * 2;
+            dsp->processInt16Multiplexd(dsp, source + base, output + base, count);
+        });
     }
     env->ReleaseShortArrayElements(inputObj, input, JNI_ABORT);
     env->ReleaseShortArrayElements(outputObj, output, 0);
@@ -363,39 +768,22 @@ Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_processInt32(JN
     auto input = env->GetIntArrayElements(inputObj, nullptr);
     auto output = env->GetIntArrayElements(outputObj, nullptr);
 
-    auto* fieldSurround = wrapper->fieldSurround;
-    const bool applyFieldSurround = fieldSurround != nullptr && fieldSurround->isEnabled();
+    const bool applyFloatChain = needsFloatChain(wrapper);
     const uint32_t frames = static_cast<uint32_t>(inputLength / 2);
 
-    if (applyFieldSurround) {
+    if (applyFloatChain) {
         std::lock_guard<std::mutex> lock(wrapper->tempBufferMutex);
-        auto* temp = getTempBuffer(wrapper, static_cast<size_t>(inputLength));
-        if (temp == nullptr) {
-            env->ReleaseIntArrayElements(inputObj, input, JNI_ABORT);
-            env->ReleaseIntArrayElements(outputObj, output, JNI_ABORT);
-            return;
-        }
         constexpr float kInputScaleInv = 1.0f / 2147483648.0f;
-        for (jsize i = 0; i < inputLength; ++i) {
-            temp[i] = static_cast<float>(static_cast<double>(input[safeOffset + i]) * kInputScaleInv);
-        }
-        fieldSurround->process(temp, frames);
-        dsp->processFloatMultiplexd(dsp, temp, temp, frames);
-
-        constexpr double kScale = 2147483648.0;
-        for (jsize i = 0; i < inputLength; ++i) {
-            const float sample = temp[i];
-            if (sample <= -1.0f) {
-                output[i] = INT32_MIN;
-            } else if (sample >= 1.0f) {
-                output[i] = INT32_MAX;
-            } else {
-                const double scaled = static_cast<double>(sample) * kScale;
-                output[i] = static_cast<jint>(scaled > 0.0 ? scaled + 0.5 : scaled - 0.5);
-            }
-        }
+        const jint* source = input + safeOffset;
+        processFloatChain(env, wrapper, dsp, frames,
+            [source](size_t i) { return static_cast<float>(static_cast<double>(source[i]) * kInputScaleInv); },
+            [output](size_t i, float sample) { output[i] = int32FromFloat(sample); });
     } else {
-        dsp->processInt32Multiplexd(dsp, input + safeOffset, output, frames);
+        const jint* source = input + safeOffset;
+        forEachBlock(wrapper, frames, [dsp, source, output](uint32_t offset, uint32_t count) {
+            const size_t base = static_cast<size_t>(offset) * 2;
+            dsp->processInt32Multiplexd(dsp, source + base, output + base, count);
+        });
     }
     env->ReleaseIntArrayElements(inputObj, input, JNI_ABORT);
     env->ReleaseIntArrayElements(outputObj, output, 0);
@@ -416,39 +804,25 @@ Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_processInt24Pac
     auto input = env->GetBooleanArrayElements(inputObj, nullptr);
     auto output = env->GetBooleanArrayElements(outputObj, nullptr);
 
-    auto* fieldSurround = wrapper->fieldSurround;
-    const bool applyFieldSurround = fieldSurround != nullptr && fieldSurround->isEnabled();
-    if (applyFieldSurround) {
+    const bool applyFloatChain = needsFloatChain(wrapper);
+    if (applyFloatChain) {
         std::lock_guard<std::mutex> lock(wrapper->tempBufferMutex);
         const int sampleCount = static_cast<int>(inputLength / 3);
         const uint32_t frames = static_cast<uint32_t>(sampleCount / 2);
-        auto* temp = getTempBuffer(wrapper, static_cast<size_t>(sampleCount));
-        if (temp == nullptr) {
-            env->ReleaseBooleanArrayElements(inputObj, input, JNI_ABORT);
-            env->ReleaseBooleanArrayElements(outputObj, output, 0);
-            return outputObj;
-        }
         auto* inputBytes = reinterpret_cast<uint8_t*>(input);
         auto* outputBytes = reinterpret_cast<uint8_t*>(output);
         constexpr float kInputScaleInv = 1.0f / 2147483648.0f;
-        for (int i = 0; i < sampleCount; ++i) {
-            temp[i] = static_cast<float>(dsp->i32_from_p24(
-                inputBytes + static_cast<size_t>(i) * 3u
-            )) * kInputScaleInv;
-        }
-        fieldSurround->process(temp, frames);
-        dsp->processFloatMultiplexd(dsp, temp, temp, frames);
-
-        for (int i = 0; i < sampleCount; ++i) {
-            dsp->p24_from_i32(clamp24FromFloat(temp[i]), outputBytes + static_cast<size_t>(i) * 3u);
-        }
+        processFloatChain(env, wrapper, dsp, frames,
+            [dsp, inputBytes](size_t i) { return static_cast<float>(dsp->i32_from_p24(inputBytes + i * 3u)) * kInputScaleInv; },
+            [dsp, outputBytes](size_t i, float sample) { dsp->p24_from_i32(clamp24FromFloat(sample), outputBytes + i * 3u); });
     } else {
-        dsp->processInt24PackedMultiplexd(
-            dsp,
-            reinterpret_cast<uint8_t*>(input),
-            reinterpret_cast<uint8_t*>(output),
-            static_cast<size_t>(inputLength / 6)
-        );
+        auto* inputBytes = reinterpret_cast<uint8_t*>(input);
+        auto* outputBytes = reinterpret_cast<uint8_t*>(output);
+        forEachBlock(wrapper, static_cast<uint32_t>(inputLength / 6),
+            [dsp, inputBytes, outputBytes](uint32_t offset, uint32_t count) {
+                const size_t base = static_cast<size_t>(offset) * 6;
+                dsp->processInt24PackedMultiplexd(dsp, inputBytes + base, outputBytes + base, count);
+            });
     }
     env->ReleaseBooleanArrayElements(inputObj, input, JNI_ABORT);
     env->ReleaseBooleanArrayElements(outputObj, output, 0);
@@ -468,38 +842,20 @@ Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_processInt8U24(
     auto input = env->GetIntArrayElements(inputObj, nullptr);
     auto output = env->GetIntArrayElements(outputObj, nullptr);
 
-    auto* fieldSurround = wrapper->fieldSurround;
-    const bool applyFieldSurround = fieldSurround != nullptr && fieldSurround->isEnabled();
-    if (applyFieldSurround) {
+    const bool applyFloatChain = needsFloatChain(wrapper);
+    if (applyFloatChain) {
         std::lock_guard<std::mutex> lock(wrapper->tempBufferMutex);
         constexpr float kInt24ScaleInv = 1.0f / 8388608.0f;
-        constexpr float kInt24Scale = 8388608.0f;
-        constexpr float kInt24Max = 8388607.0f;
-        constexpr float kInt24Min = -8388608.0f;
         const uint32_t frames = static_cast<uint32_t>(inputLength / 2);
-        auto* temp = getTempBuffer(wrapper, static_cast<size_t>(inputLength));
-        if (temp == nullptr) {
-            env->ReleaseIntArrayElements(inputObj, input, JNI_ABORT);
-            env->ReleaseIntArrayElements(outputObj, output, 0);
-            return outputObj;
-        }
-        for (int i = 0; i < inputLength; ++i) {
-            temp[i] = static_cast<float>(input[i]) * kInt24ScaleInv;
-        }
-        fieldSurround->process(temp, frames);
-        dsp->processFloatMultiplexd(dsp, temp, temp, frames);
-
-        for (int i = 0; i < inputLength; ++i) {
-            float scaled = temp[i] * kInt24Scale;
-            if (scaled > kInt24Max) {
-                scaled = kInt24Max;
-            } else if (scaled < kInt24Min) {
-                scaled = kInt24Min;
-            }
-            output[i] = static_cast<jint>(scaled > 0.0f ? scaled + 0.5f : scaled - 0.5f);
-        }
+        processFloatChain(env, wrapper, dsp, frames,
+            [input](size_t i) { return static_cast<float>(input[i]) * kInt24ScaleInv; },
+            [output](size_t i, float sample) { output[i] = int8U24FromFloat(sample); });
     } else {
-        dsp->processInt8_24Multiplexd(dsp, input, output, static_cast<size_t>(inputLength / 2));
+        forEachBlock(wrapper, static_cast<uint32_t>(inputLength / 2),
+            [dsp, input, output](uint32_t offset, uint32_t count) {
+                const size_t base = static_cast<size_t>(offset) * 2;
+                dsp->processInt8_24Multiplexd(dsp, input + base, output + base, count);
+            });
     }
     env->ReleaseIntArrayElements(inputObj, input, JNI_ABORT);
     env->ReleaseIntArrayElements(outputObj, output, 0);
@@ -537,24 +893,20 @@ Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_processFloat(JN
 
     auto input = env->GetFloatArrayElements(inputObj, nullptr);
     auto output = env->GetFloatArrayElements(outputObj, nullptr);
-    auto* fieldSurround = wrapper->fieldSurround;
-    const bool applyFieldSurround = fieldSurround != nullptr && fieldSurround->isEnabled();
+    const bool applyFloatChain = needsFloatChain(wrapper);
     const uint32_t frames = static_cast<uint32_t>(inputLength / 2);
-    if (applyFieldSurround) {
+    if (applyFloatChain) {
         std::lock_guard<std::mutex> lock(wrapper->tempBufferMutex);
-        auto* temp = getTempBuffer(wrapper, static_cast<size_t>(inputLength));
-        if (temp == nullptr) {
-            env->ReleaseFloatArrayElements(inputObj, input, JNI_ABORT);
-            env->ReleaseFloatArrayElements(outputObj, output, JNI_ABORT);
-            return;
-        }
-        for (jsize i = 0; i < inputLength; ++i) {
-            temp[i] = input[safeOffset + i];
-        }
-        fieldSurround->process(temp, frames);
-        dsp->processFloatMultiplexd(dsp, temp, output, frames);
+        const jfloat* source = input + safeOffset;
+        processFloatChain(env, wrapper, dsp, frames,
+            [source](size_t i) { return source[i]; },
+            [output](size_t i, float sample) { output[i] = sample; });
     } else {
-        dsp->processFloatMultiplexd(dsp, input + safeOffset, output, frames);
+        const jfloat* source = input + safeOffset;
+        forEachBlock(wrapper, frames, [dsp, source, output](uint32_t offset, uint32_t count) {
+            const size_t base = static_cast<size_t>(offset) * 2;
+            dsp->processFloatMultiplexd(dsp, source + base, output + base, count);
+        });
     }
 
     env->ReleaseFloatArrayElements(inputObj, input, JNI_ABORT);
@@ -629,6 +981,23 @@ Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_setClarity(
         ClarityDisable(dsp);
     }
 
+    if (wrapper->chainResponse != nullptr) {
+        wrapper->chainResponse->setClarity(
+            enable,
+            safeMode,
+            safeGain,
+            safePostGainDb,
+            naturalLpfOffsetHz,
+            ozoneFreqHz,
+            xhifiLowCutHz,
+            xhifiHighCutHz,
+            safeXhifiHpMix,
+            safeXhifiBpMix,
+            xhifiBpDelayDivisor,
+            xhifiLpDelayDivisor
+        );
+    }
+
     return true;
 }
 
@@ -658,6 +1027,8 @@ Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_setMultiEqualiz
     {
         LOGW("JamesDspWrapper::setMultiEqualizer: EQ band pointer is NULL. Disabling EQ");
         MultimodalEqualizerDisable(dsp);
+        if(wrapper->chainResponse != nullptr)
+            wrapper->chainResponse->setMultiEqualizer(false, filterType, interpolationMode, nullptr);
         return true;
     }
 
@@ -665,12 +1036,16 @@ Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_setMultiEqualiz
     {
         auto* nativeBands = (env->GetDoubleArrayElements(bands, nullptr));
         MultimodalEqualizerAxisInterpolation(dsp, interpolationMode, filterType, nativeBands, nativeBands + 15);
+        if(wrapper->chainResponse != nullptr)
+            wrapper->chainResponse->setMultiEqualizer(true, filterType, interpolationMode, nativeBands);
         env->ReleaseDoubleArrayElements(bands, nativeBands, JNI_ABORT);
         MultimodalEqualizerEnable(dsp, 1);
     }
     else
     {
         MultimodalEqualizerDisable(dsp);
+        if(wrapper->chainResponse != nullptr)
+            wrapper->chainResponse->setMultiEqualizer(false, filterType, interpolationMode, nullptr);
     }
     return true;
 }
@@ -764,6 +1139,8 @@ Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_setConvolver(JN
     DECLARE_DSP_B
 
     int success = 1;
+    const bool partitionedMode = wrapper->partitionedConvolution.load();
+    convolver::PartitionedConvolver* partitioned = nullptr;
     if(env->GetArrayLength(impulseResponse) <= 0)
     {
         LOGW("JamesDspWrapper::setConvolver: Impulse response array is empty. Disabling convolver");
@@ -782,18 +1159,38 @@ Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_setConvolver(JN
         Convolver1DDisable(dsp);
 
         auto* nativeImpulse = (env->GetFloatArrayElements(impulseResponse, nullptr));
-        success = Convolver1DLoadImpulseResponse(dsp, nativeImpulse, irChannels, irFrames, 1);
+        if(partitionedMode)
+        {
+            // Transformed here on the caller's thread, the audio thread only sees the finished convolver
+            const auto precision = wrapper->halfPrecisionSpectra.load() ? convolver::SpectrumPrecision::Half
+                                                                        : convolver::SpectrumPrecision::Float;
+            partitioned = new convolver::PartitionedConvolver();
+            success = partitioned->load(nativeImpulse, irChannels, irFrames, precision) ? 1 : 0;
+            if(success <= 0)
+            {
+                delete partitioned;
+                partitioned = nullptr;
+            }
+            else
+            {
+                LOGD("JamesDspWrapper::setConvolver: partitioned spectra take %zu bytes", partitioned->spectrumBytes());
+            }
+        }
+        else
+            success = Convolver1DLoadImpulseResponse(dsp, nativeImpulse, irChannels, irFrames, 1);
         env->ReleaseFloatArrayElements(impulseResponse, nativeImpulse, JNI_ABORT);
     }
 
-    if(enable)
+    replacePartitionedConvolver(wrapper, partitioned);
+    if(enable && !partitionedMode)
         Convolver1DEnable(dsp);
     else
         Convolver1DDisable(dsp);
 
     if(success <= 0)
     {
-        LOGD("JamesDspWrapper::setConvolver: Failed to update convolver. Convolver1DLoadImpulseResponse returned an error.");
+        LOGD("JamesDspWrapper::setConvolver: Failed to update convolver. %s returned an error.",
+             partitionedMode ? "PartitionedConvolver::load" : "Convolver1DLoadImpulseResponse");
         return false;
     }
 
@@ -815,12 +1212,18 @@ Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_setGraphicEq(JN
     {
         const char *nativeString = env->GetStringUTFChars(graphicEq, nullptr);
         ArbitraryResponseEqualizerStringParser(dsp, (char*)nativeString);
+        if(wrapper->chainResponse != nullptr)
+            wrapper->chainResponse->setGraphicEq(true, nativeString);
         env->ReleaseStringUTFChars(graphicEq, nativeString);
 
         ArbitraryResponseEqualizerEnable(dsp, 1);
     }
     else
+    {
         ArbitraryResponseEqualizerDisable(dsp);
+        if(wrapper->chainResponse != nullptr)
+            wrapper->chainResponse->setGraphicEq(false, nullptr);
+    }
 
     return true;
 }
@@ -863,6 +1266,8 @@ Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_setBassBoost(JN
     {
         BassBoostDisable(dsp);
     }
+    if(wrapper->chainResponse != nullptr)
+        wrapper->chainResponse->setBassBoost(enable, maxGain);
     return true;
 }
 
@@ -913,6 +1318,8 @@ Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_setFieldSurroun
         return std::isfinite(value) ? value : fallback;
     };
 
+    // Applied between two processing blocks, FieldSurround ramps delay and filter changes from there
+    std::lock_guard<std::mutex> lock(wrapper->tempBufferMutex);
     fieldSurround->setOutputModeFromParamInt(outputMode);
     fieldSurround->setWidenFromParamInt(widening);
     fieldSurround->setMidFromParamInt(midImage);
@@ -937,6 +1344,39 @@ Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_setFieldSurroun
     return true;
 }
 
+extern "C" JNIEXPORT jboolean JNICALL
+Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_computeChainResponse(JNIEnv *env, jobject obj, jlong self,
+                                                                                     jdoubleArray dispFreq, jfloatArray magnitudeDb, jfloatArray phase)
+{
+    DECLARE_DSP_B
+    auto* chainResponse = wrapper->chainResponse;
+    RETURN_IF_NULL(chainResponse, false)
+    RETURN_IF_NULL(wrapper->fieldSurround, false)
+
+    const jsize nPts = env->GetArrayLength(dispFreq);
+    if(nPts <= 0 || env->GetArrayLength(magnitudeDb) < nPts * 2 || env->GetArrayLength(phase) < nPts * 2)
+    {
+        LOGE("JamesDspWrapper::computeChainResponse: Output arrays must hold two channels of %d points", nPts);
+        return false;
+    }
+
+    // Snapshot of the FieldSurround parameters, the processor itself keeps running on the audio thread
+    fieldsurround::FieldSurroundProcessor::ResponseParams fieldSurround;
+    {
+        std::lock_guard<std::mutex> lock(wrapper->tempBufferMutex);
+        fieldSurround = wrapper->fieldSurround->responseParams();
+    }
+
+    auto* nativeFreq = env->GetDoubleArrayElements(dispFreq, nullptr);
+    auto* nativeMagnitude = env->GetFloatArrayElements(magnitudeDb, nullptr);
+    auto* nativePhase = env->GetFloatArrayElements(phase, nullptr);
+    const bool success = chainResponse->compute(static_cast<uint32_t>(dsp->fs), fieldSurround, nativeFreq, nPts, nativeMagnitude, nativePhase);
+    env->ReleaseFloatArrayElements(phase, nativePhase, success ? 0 : JNI_ABORT);
+    env->ReleaseFloatArrayElements(magnitudeDb, nativeMagnitude, success ? 0 : JNI_ABORT);
+    env->ReleaseDoubleArrayElements(dispFreq, nativeFreq, JNI_ABORT);
+    return success;
+}
+
 extern "C" JNIEXPORT jboolean JNICALL
 Java_me_timschneeberger_rootlessjamesdsp_interop_JamesDspWrapper_setVacuumTube(JNIEnv *env, jobject obj, jlong self,
                                                                               jboolean enable, jfloat level)
@@ -1184,6 +1624,15 @@ void receiveLiveprogStdOut(const char *buffer, void* userData)
         return;
     }
 
+    if(onPipelineThread)
+    {
+        std::lock_guard<std::mutex> lock(self->liveprogOutputMutex);
+        if(self->liveprogOutput.size() < kMaxQueuedLiveprogLines)
+            self->liveprogOutput.emplace_back(buffer);
+        self->liveprogOutputPending.store(true, std::memory_order_release);
+        return;
+    }
+
     self->env->CallVoidMethod(self->callbackInterface, self->callbackOnLiveprogOutput, self->env->NewStringUTF(buffer));
 }
 
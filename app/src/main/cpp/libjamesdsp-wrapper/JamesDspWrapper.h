@@ -2,25 +2,69 @@
 #define DSPHOST_H
 
 #include <jni.h>
+#include <atomic>
+#include <cstdint>
 #include <mutex>
+#include <string>
 #include <vector>
 
+#include "planar/PlanarBuffer.h"
+
 namespace fieldsurround {
 class FieldSurroundProcessor;
 }
 
+namespace fixedrate {
+class EdgeResampler;
+}
+
+namespace chainpreview {
+class ChainResponse;
+}
+
+namespace pipeline {
+class TwoStageRunner;
+}
+
+namespace convolver {
+class PartitionedConvolver;
+}
+
+// Sub-block size for large process calls: 512 stereo float frames keep the planar block, the device
+// buffer slice and the core's scratch for that slice within L1 on current ARM cores
+constexpr uint32_t kDefaultBlockFrames = 512;
+constexpr uint32_t kMinBlockFrames = 64;
+constexpr uint32_t kMaxBlockFrames = 16384;
+
 typedef struct
 {
     void* dsp;
     fieldsurround::FieldSurroundProcessor* fieldSurround;
+    fixedrate::EdgeResampler* edgeResampler;
+    chainpreview::ChainResponse* chainResponse;
+    // Non-null while pipelined processing is on
+    pipeline::TwoStageRunner* twoStage;
+    // Non-null while the wrapper runs the convolver itself, the libjamesdsp convolver stays off then
+    convolver::PartitionedConvolver* partitionedConvolver;
     JNIEnv* env;
     jobject callbackInterface;
     jmethodID callbackOnLiveprogOutput;
     jmethodID callbackOnLiveprogExec;
     jmethodID callbackOnLiveprogResult;
     jmethodID callbackOnVdcParseError;
+    // Liveprog output printed on the pipeline runner's thread, which has no JNIEnv. The next process call
+    // hands it to the callback from the caller's thread.
+    std::mutex liveprogOutputMutex;
+    std::vector<std::string> liveprogOutput;
+    std::atomic<bool> liveprogOutputPending{false};
     std::mutex tempBufferMutex;
     std::vector<float> tempBuffer;
+    planar::PlanarBuffer planarBuffer;
+    std::atomic<uint32_t> blockFrames{kDefaultBlockFrames};
+    // Impulse responses go to partitionedConvolver instead of the libjamesdsp convolver
+    std::atomic<bool> partitionedConvolution{false};
+    // partitionedConvolver keeps its tail spectra in half precision
+    std::atomic<bool> halfPrecisionSpectra{false};
 } JamesDspWrapper;
 
 /* C interop function */
@@ -0,0 +1,257 @@
+#include "ChainResponse.h"
+
+#include <android/log.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#define TAG "ChainResponse_JNI"
+#include <Log.h>
+
+extern "C" {
+#include <jdsp_header.h>
+#include "coeffcache.h"
+}
+
+namespace chainpreview {
+
+static constexpr double PI = 3.14159265358979323846;
+// Low enough that no stage or the output limiter of the scratch engine is driven into its level dependent range
+static constexpr float kProbeLevel = 1.0f / 256.0f;
+// Long enough for the impulse response tail of every measured stage to decay
+static constexpr uint32_t kProbeFrames = 1u << 15;
+static constexpr uint32_t kProbeBlockFrames = 1024;
+
+// In place radix-2 decimation in time FFT, n is a power of two
+static void fft(std::vector<std::complex<double>>& x) {
+    const size_t n = x.size();
+    for (size_t i = 1, j = 0; i < n; ++i) {
+        size_t bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            std::swap(x[i], x[j]);
+        }
+    }
+    for (size_t len = 2; len <= n; len <<= 1) {
+        const std::complex<double> step = std::polar(1.0, -2.0 * PI / static_cast<double>(len));
+        for (size_t i = 0; i < n; i += len) {
+            std::complex<double> w = 1.0;
+            for (size_t k = 0; k < len / 2; ++k) {
+                const std::complex<double> u = x[i + k];
+                const std::complex<double> v = x[i + k + len / 2] * w;
+                x[i + k] = u + v;
+                x[i + k + len / 2] = u - v;
+                w *= step;
+            }
+        }
+    }
+}
+
+void ChainResponse::setMultiEqualizer(bool enable, int filterType, int interpolationMode, const double* bands) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stages.eqEnabled = enable && bands != nullptr;
+    if (stages.eqEnabled) {
+        stages.eqFilterType = filterType;
+        stages.eqInterpolationMode = interpolationMode;
+        std::memcpy(stages.eqBands, bands, sizeof(stages.eqBands));
+    }
+}
+
+void ChainResponse::setGraphicEq(bool enable, const char* value) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stages.graphicEqEnabled = enable && value != nullptr;
+    if (stages.graphicEqEnabled) {
+        stages.graphicEq = value;
+    }
+}
+
+void ChainResponse::setBassBoost(bool enable, float maxGain) {
+    std::lock_guard<std::mutex> lock(mutex);
+    stages.bassBoostEnabled = enable;
+    stages.bassBoostMaxGain = maxGain;
+}
+
+void ChainResponse::setClarity(bool enable, int mode, float gain, float postGainDb, int naturalLpfOffsetHz, int ozoneFreqHz,
+                               int xhifiLowCutHz, int xhifiHighCutHz, float xhifiHpMix, float xhifiBpMix,
+                               int xhifiBpDelayDivisor, int xhifiLpDelayDivisor) {
+    std::lock_guard<std::mutex> lock(mutex);
+    clarity.setMode(mode);
+    clarity.setGainLinear(gain);
+    clarity.setPostGainDb(postGainDb);
+    clarity.setNaturalLpfOffsetHz(naturalLpfOffsetHz);
+    clarity.setOzoneFreqHz(ozoneFreqHz);
+    clarity.setXhifiParams(xhifiLowCutHz, xhifiHighCutHz, xhifiHpMix, xhifiBpMix, xhifiBpDelayDivisor, xhifiLpDelayDivisor);
+    clarity.setEnabled(enable);
+}
+
+uint64_t ChainResponse::MeasuredStages::hash(const double* dispFreq, int nPts) const {
+    const int flags = (eqEnabled ? 1 : 0) | (graphicEqEnabled ? 2 : 0) | (bassBoostEnabled ? 4 : 0);
+    uint64_t h = coeffCacheHash(&flags, sizeof(flags), COEFFCACHE_HASH_SEED);
+    if (eqEnabled) {
+        h = coeffCacheHash(&eqFilterType, sizeof(eqFilterType), h);
+        h = coeffCacheHash(&eqInterpolationMode, sizeof(eqInterpolationMode), h);
+        h = coeffCacheHash(eqBands, sizeof(eqBands), h);
+    }
+    if (graphicEqEnabled) {
+        h = coeffCacheHash(graphicEq.data(), graphicEq.size(), h);
+    }
+    if (bassBoostEnabled) {
+        h = coeffCacheHash(&bassBoostMaxGain, sizeof(bassBoostMaxGain), h);
+    }
+    return coeffCacheHash(dispFreq, static_cast<size_t>(nPts) * sizeof(double), h);
+}
+
+bool ChainResponse::measure(const MeasuredStages& stages, uint32_t samplingRate, const double* dispFreq, int nPts,
+                            std::vector<std::complex<double>>& matrix) const {
+    const uint32_t frames = kProbeFrames;
+
+    // libjamesdsp takes its parameters through non-const pointers
+    std::vector<double> bands(stages.eqBands, stages.eqBands + kEqBands);
+    std::vector<char> graphic(stages.graphicEq.begin(), stages.graphicEq.end());
+    graphic.push_back('\0');
+
+    // A fresh engine per input channel so the first probe's tail cannot leak into the second. The engines
+    // are set up one after the other, only the probe runs overlap.
+    JamesDSPLib* lib[2] = {nullptr, nullptr};
+    const auto release = [&lib]() {
+        for (JamesDSPLib* engine : lib) {
+            if (engine != nullptr) {
+                JamesDSPFree(engine);
+                free(engine);
+            }
+        }
+    };
+    for (int in = 0; in < 2; ++in) {
+        lib[in] = static_cast<JamesDSPLib*>(malloc(sizeof(JamesDSPLib)));
+        if (lib[in] == nullptr) {
+            LOGE("ChainResponse::measure: Failed to allocate scratch engine");
+            release();
+            return false;
+        }
+        memset(lib[in], 0, sizeof(JamesDSPLib));
+        JamesDSPInit(lib[in], 128, static_cast<float>(samplingRate));
+        if (stages.eqEnabled) {
+            MultimodalEqualizerAxisInterpolation(lib[in], stages.eqInterpolationMode, stages.eqFilterType, bands.data(), bands.data() + 15);
+            MultimodalEqualizerEnable(lib[in], 1);
+        }
+        if (stages.graphicEqEnabled) {
+            ArbitraryResponseEqualizerStringParser(lib[in], graphic.data());
+            ArbitraryResponseEqualizerEnable(lib[in], 1);
+        }
+        if (stages.bassBoostEnabled) {
+            BassBoostSetParam(lib[in], stages.bassBoostMaxGain);
+            BassBoostEnable(lib[in]);
+        }
+    }
+
+    std::vector<std::complex<double>> spectrum[2];
+    const auto runProbe = [&](int in) {
+        JamesDSPLib* engine = lib[in];
+        std::vector<float> probe(static_cast<size_t>(frames) * 2, 0.0f);
+        probe[in] = kProbeLevel;
+        for (uint32_t offset = 0; offset < frames; offset += kProbeBlockFrames) {
+            float* block = probe.data() + static_cast<size_t>(offset) * 2;
+            engine->processFloatMultiplexd(engine, block, block, std::min(kProbeBlockFrames, frames - offset));
+        }
+
+        // Both output channels share one complex transform, left in the real and right in the imaginary part
+        spectrum[in].resize(frames);
+        for (uint32_t i = 0; i < frames; ++i) {
+            spectrum[in][i] = std::complex<double>(probe[i * 2], probe[i * 2 + 1]);
+        }
+        fft(spectrum[in]);
+    };
+    // The right channel probe runs on a thread of its own while this one measures the left channel
+    std::thread right(runProbe, 1);
+    runProbe(0);
+    right.join();
+    release();
+
+    auto bin = [frames](const std::vector<std::complex<double>>& z, uint32_t k, int out) {
+        const std::complex<double> a = z[k];
+        const std::complex<double> b = std::conj(z[(frames - k) & (frames - 1)]);
+        return out == 0 ? (a + b) * 0.5 : (a - b) * std::complex<double>(0.0, -0.5);
+    };
+
+    matrix.resize(static_cast<size_t>(nPts) * 4);
+    const double binsPerHz = static_cast<double>(frames) / static_cast<double>(samplingRate);
+    for (int i = 0; i < nPts; ++i) {
+        const double position = std::clamp(dispFreq[i] * binsPerHz, 0.0, static_cast<double>(frames / 2));
+        const auto k0 = static_cast<uint32_t>(position);
+        const uint32_t k1 = std::min(k0 + 1, frames / 2);
+        const double frac = position - static_cast<double>(k0);
+        for (int out = 0; out < 2; ++out) {
+            for (int in = 0; in < 2; ++in) {
+                const std::complex<double> h = bin(spectrum[in], k0, out) * (1.0 - frac) + bin(spectrum[in], k1, out) * frac;
+                matrix[static_cast<size_t>(i) * 4 + out * 2 + in] = h / static_cast<double>(kProbeLevel);
+            }
+        }
+    }
+    return true;
+}
+
+bool ChainResponse::compute(uint32_t samplingRate, const fieldsurround::FieldSurroundProcessor::ResponseParams& fieldSurround,
+                            const double* dispFreq, int nPts, float* magnitudeDb, float* phase) {
+    if (samplingRate == 0 || dispFreq == nullptr || nPts <= 0 || magnitudeDb == nullptr || phase == nullptr) {
+        return false;
+    }
+
+    MeasuredStages snapshot;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        snapshot = stages;
+    }
+
+    std::vector<std::complex<double>> matrix;
+    if (snapshot.any()) {
+        const size_t bytes = static_cast<size_t>(nPts) * 4 * sizeof(std::complex<double>);
+        const uint64_t key = snapshot.hash(dispFreq, nPts);
+        size_t size = 0;
+        void* cached = coeffCacheLookup(COEFFCACHE_EFFECT_CHAIN_STAGES, key, static_cast<int>(samplingRate), &size);
+        if (cached != nullptr && size == bytes) {
+            matrix.resize(static_cast<size_t>(nPts) * 4);
+            std::memcpy(matrix.data(), cached, bytes);
+        }
+        free(cached);
+        if (matrix.empty()) {
+            if (!measure(snapshot, samplingRate, dispFreq, nPts, matrix)) {
+                return false;
+            }
+            coeffCacheStore(COEFFCACHE_EFFECT_CHAIN_STAGES, key, static_cast<int>(samplingRate), matrix.data(), bytes);
+        }
+    }
+
+    // Clarity is evaluated analytically, cheap enough to keep the setters out for the whole loop
+    std::lock_guard<std::mutex> lock(mutex);
+    clarity.setSamplingRate(samplingRate);
+    for (int i = 0; i < nPts; ++i) {
+        std::complex<double> surround[2][2];
+        fieldSurround.frequencyResponse(dispFreq[i], surround);
+        // Centered mono source, both inputs carry the same signal
+        std::complex<double> left = surround[0][0] + surround[0][1];
+        std::complex<double> right = surround[1][0] + surround[1][1];
+        if (!matrix.empty()) {
+            const std::complex<double>* m = matrix.data() + static_cast<size_t>(i) * 4;
+            const std::complex<double> l = m[0] * left + m[1] * right;
+            right = m[2] * left + m[3] * right;
+            left = l;
+        }
+        // Clarity treats both channels alike, so its position in the libjamesdsp chain does not matter
+        const std::complex<double> c = clarity.frequencyResponse(dispFreq[i]);
+        left *= c;
+        right *= c;
+
+        magnitudeDb[i] = static_cast<float>(20.0 * std::log10(std::max(std::abs(left), 1.0e-10)));
+        magnitudeDb[nPts + i] = static_cast<float>(20.0 * std::log10(std::max(std::abs(right), 1.0e-10)));
+        phase[i] = static_cast<float>(std::arg(left));
+        phase[nPts + i] = static_cast<float>(std::arg(right));
+    }
+    return true;
+}
+
+} // namespace chainpreview
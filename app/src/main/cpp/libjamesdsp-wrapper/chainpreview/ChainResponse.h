@@ -0,0 +1,67 @@
+#pragma once
+
+#include <complex>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../clarity/ClarityProcessor.h"
+#include "../fieldsurround/FieldSurroundProcessor.h"
+
+namespace chainpreview {
+
+// Transfer function of the whole effect chain for the UI preview, evaluated at the display frequencies.
+// FieldSurround and Clarity are evaluated analytically from their coefficients. The libjamesdsp stages
+// that only expose a parameter interface (multimodal EQ, graphic EQ, bass boost) are measured once per
+// parameter set with a low level impulse through a scratch engine and cached in the coefficient cache,
+// so moving a Clarity or FieldSurround control never re-measures them.
+// Level dependent processing (limiter, Clarity safety, compander, tube, ...) is not part of the response,
+// neither is the convolver: measuring it would mean keeping a second copy of the impulse response.
+class ChainResponse {
+public:
+    // The setters mirror the JNI setters of the live chain
+    void setMultiEqualizer(bool enable, int filterType, int interpolationMode, const double* bands);
+    void setGraphicEq(bool enable, const char* graphicEq);
+    void setBassBoost(bool enable, float maxGain);
+    void setClarity(bool enable, int mode, float gain, float postGainDb, int naturalLpfOffsetHz, int ozoneFreqHz,
+                    int xhifiLowCutHz, int xhifiHighCutHz, float xhifiHpMix, float xhifiBpMix,
+                    int xhifiBpDelayDivisor, int xhifiLpDelayDivisor);
+
+    // Response to a centered mono input at nPts display frequencies. magnitudeDb and phase (radians)
+    // receive the left channel in [0, nPts) and the right channel in [nPts, 2 * nPts).
+    bool compute(uint32_t samplingRate, const fieldsurround::FieldSurroundProcessor::ResponseParams& fieldSurround,
+                 const double* dispFreq, int nPts, float* magnitudeDb, float* phase);
+
+private:
+    static constexpr int kEqBands = 30;
+
+    // Parameters of the measured stages. compute() copies them under the mutex and measures without it,
+    // so the setters never wait for a probe run.
+    struct MeasuredStages {
+        bool eqEnabled = false;
+        int eqFilterType = 0;
+        int eqInterpolationMode = 0;
+        double eqBands[kEqBands] = {};
+
+        bool graphicEqEnabled = false;
+        std::string graphicEq;
+
+        bool bassBoostEnabled = false;
+        float bassBoostMaxGain = 0.0f;
+
+        bool any() const { return eqEnabled || graphicEqEnabled || bassBoostEnabled; }
+        uint64_t hash(const double* dispFreq, int nPts) const;
+    };
+
+    // Fills matrix with 4 values per display point: out L <- in L, out L <- in R, out R <- in L, out R <- in R
+    bool measure(const MeasuredStages& stages, uint32_t samplingRate, const double* dispFreq, int nPts,
+                 std::vector<std::complex<double>>& matrix) const;
+
+    std::mutex mutex;
+    MeasuredStages stages;
+
+    clarity::ClarityProcessor clarity;
+};
+
+} // namespace chainpreview
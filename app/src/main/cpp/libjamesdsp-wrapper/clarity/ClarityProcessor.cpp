@@ -34,75 +34,28 @@ float IIR1::process(float sample) {
     return sample;
 }
 
-NOrderBW_LH::NOrderBW_LH(uint32_t order) : filters(order) {
-    mute();
+std::complex<double> IIR1::response(std::complex<double> zInv) const {
+    // y = b0 * x + s[n-1], s = a1 * y + b1 * x
+    return (static_cast<double>(b0) + static_cast<double>(b1) * zInv) / (1.0 - static_cast<double>(a1) * zInv);
 }
 
-void NOrderBW_LH::mute() {
-    for (auto& f : filters) f.mute();
-}
-
-void NOrderBW_LH::setLPF(float frequency, uint32_t samplingRate) {
-    for (auto& f : filters) f.setLPF_BW(frequency, samplingRate);
-}
-
-void NOrderBW_LH::setHPF(float frequency, uint32_t samplingRate) {
-    for (auto& f : filters) f.setHPF_BW(frequency, samplingRate);
-}
-
-float NOrderBW_LH::process(float sample) {
-    for (auto& f : filters) sample = f.process(sample);
-    return sample;
-}
+StereoDelayLine::StereoDelayLine() : samples(static_cast<size_t>(kCapacityFrames) * 2, 0.0f) {}
 
-NOrderBW_BP::NOrderBW_BP(uint32_t order) : lowpass(order), highpass(order) {
-    mute();
+void StereoDelayLine::setDelay(uint32_t frames) {
+    delay = std::min(frames, kMaxDelayFrames);
+    clear();
 }
 
-void NOrderBW_BP::mute() {
-    for (auto& f : lowpass) f.mute();
-    for (auto& f : highpass) f.mute();
+void StereoDelayLine::clear() {
+    std::fill(samples.begin(), samples.end(), 0.0f);
+    writeIndex = 0;
 }
 
-void NOrderBW_BP::setBPF(float lowCut, float highCut, uint32_t samplingRate) {
-    for (auto& f : lowpass) f.setLPF_BW(highCut, samplingRate);
-    for (auto& f : highpass) f.setHPF_BW(lowCut, samplingRate);
-}
-
-float NOrderBW_BP::process(float sample) {
-    for (auto& f : lowpass) sample = f.process(sample);
-    for (auto& f : highpass) sample = f.process(sample);
-    return sample;
-}
-
-WaveBuffer::WaveBuffer(uint32_t channels_, uint32_t length) : buffer(length * channels_), channels(channels_) {}
-
-void WaveBuffer::reset() { index = 0; }
-
-float* WaveBuffer::pushZerosGetBuffer(uint32_t frames) {
-    const uint32_t oldIndex = index;
-    if (frames > 0) {
-        const uint32_t required = channels * frames + index;
-        if (required > buffer.size()) buffer.resize(required);
-        std::memset(buffer.data() + index, 0, channels * frames * sizeof(float));
-        index += channels * frames;
-    }
-    return buffer.data() + oldIndex;
-}
-
-void WaveBuffer::pushZeros(uint32_t frames) {
-    if (frames == 0) return;
-    const uint32_t required = channels * frames + index;
-    if (required > buffer.size()) buffer.resize(required);
-    std::memset(buffer.data() + index, 0, channels * frames * sizeof(float));
-    index += channels * frames;
-}
-
-void WaveBuffer::popSamples(uint32_t frames) {
-    const uint32_t amount = channels * frames;
-    if (amount > index) return;
-    index -= amount;
-    std::memmove(buffer.data(), buffer.data() + amount, index * sizeof(float));
+uint32_t StereoDelayLine::span() const {
+    // Writing more than kCapacityFrames - delay frames would overwrite samples still to be read
+    const uint32_t toWriteWrap = kCapacityFrames - (writeIndex & mask);
+    const uint32_t toReadWrap = kCapacityFrames - ((writeIndex - delay) & mask);
+    return std::min({kCapacityFrames - delay, toWriteWrap, toReadWrap});
 }
 
 void NoiseSharpening::setSamplingRate(uint32_t sr) {
@@ -132,11 +85,11 @@ void NoiseSharpening::reset() {
     }
 }
 
-void NoiseSharpening::process(float* buffer, uint32_t frames) {
+template <typename Frames>
+void NoiseSharpening::process(Frames block, uint32_t frames) {
     for (uint32_t i = 0; i < frames; ++i) {
         for (int ch = 0; ch < 2; ++ch) {
-            const uint32_t idx = i * 2 + ch;
-            const float sample = buffer[idx];
+            float& sample = block.at(ch, i);
             const float prev = prevIn[ch];
             prevIn[ch] = sample;
             const float xIn = sample + (sample - prev) * gain;
@@ -144,11 +97,18 @@ void NoiseSharpening::process(float* buffer, uint32_t frames) {
             const float hist = xIn * filter.b1;
             const float out = filter.prevSample + xIn * filter.b0;
             filter.prevSample = xIn * filter.a1 + hist;
-            buffer[idx] = out;
+            sample = out;
         }
     }
 }
 
+std::complex<double> NoiseSharpening::response(std::complex<double> zInv) const {
+    // The inlined filter feeds its state from the sharpened input, not from its output
+    const IIR1& f = filters[0];
+    const std::complex<double> sharpen = 1.0 + static_cast<double>(gain) * (1.0 - zInv);
+    return sharpen * (static_cast<double>(f.b0) + (static_cast<double>(f.a1) + static_cast<double>(f.b1)) * zInv);
+}
+
 void HighShelf::setGainLinear(float gain) {
     const float safeGain = std::max(gain, std::numeric_limits<float>::min());
     gainDb = 20.0 * std::log10(static_cast<double>(safeGain));
@@ -160,8 +120,6 @@ void HighShelf::setSamplingRate(uint32_t samplingRate) {
     const double cosX = std::cos(x);
     const double y = std::exp((gainDb * std::log(10.0)) / 40.0);
 
-    x1 = x2 = y1 = y2 = 0.0;
-
     const double z = std::sqrt(y * 2.0) * sinX;
     const double a = (y - 1.0) * cosX;
     const double b = (y + 1.0) - a;
@@ -170,24 +128,24 @@ void HighShelf::setSamplingRate(uint32_t samplingRate) {
     const double e = (y + 1.0) + a;
     const double f = (y - 1.0) - d;
 
-    a0 = 1.0 / c;
-    a1 = f * 2.0;
-    a2 = b - z;
-    b0 = (e + z) * y;
-    b1 = -y * 2.0 * ((y - 1.0) + d);
-    b2 = (e - z) * y;
+    const double a0 = 1.0 / c;
+    stereobiquad::Coefficients coefficients;
+    coefficients.b0 = (e + z) * y * a0;
+    coefficients.b1 = -y * 2.0 * ((y - 1.0) + d) * a0;
+    coefficients.b2 = (e - z) * y * a0;
+    coefficients.a1 = f * 2.0 * a0;
+    coefficients.a2 = (b - z) * a0;
+    filter.setCoefficients(0, coefficients);
+    filter.reset();
 }
 
-float HighShelf::process(float sample) {
-    const double out = (((x1 * b1 + sample * b0 + b2 * x2) - y1 * a1) - a2 * y2) * a0;
-    y2 = y1;
-    y1 = out;
-    x2 = x1;
-    x1 = sample;
-    return static_cast<float>(out);
+void HighShelf::process(InterleavedFrames block, uint32_t frames) {
+    filter.process(block.samples, frames);
 }
 
-HiFi::HiFi() : bpBuffer(2, 0x800), lpBuffer(2, 0x800) {}
+void HighShelf::process(PlanarFrames block, uint32_t frames) {
+    filter.processPlanar(block.channels[0], block.channels[1], frames);
+}
 
 void HiFi::setSamplingRate(uint32_t sr) {
     if (samplingRate != sr) {
@@ -226,49 +184,81 @@ void HiFi::setLpDelayDivisor(int divisor) {
 }
 
 void HiFi::reset() {
-    for (int i = 0; i < 2; ++i) {
-        filters[i].lowpass.setLPF(lowCutHz, samplingRate);
-        filters[i].lowpass.mute();
-        filters[i].highpass.setHPF(highCutHz, samplingRate);
-        filters[i].highpass.mute();
-        filters[i].bandpass.setBPF(lowCutHz, highCutHz, samplingRate);
-        filters[i].bandpass.mute();
-    }
-
-    bpBuffer.reset();
-    bpBuffer.pushZeros(static_cast<uint32_t>(samplingRate / bpDelayDivisor));
-    lpBuffer.reset();
-    lpBuffer.pushZeros(static_cast<uint32_t>(samplingRate / lpDelayDivisor));
-}
-
-void HiFi::process(float* samples, uint32_t frames) {
-    if (frames == 0) return;
-
-    float* bpWrite = bpBuffer.pushZerosGetBuffer(frames);
-    float* lpWrite = lpBuffer.pushZerosGetBuffer(frames);
+    highAndBandLow.setHPF(0, highCutHz, samplingRate);
+    highAndBandLow.setLPF(1, highCutHz, samplingRate);
+    highAndBandLow.mute();
+    bandHighAndLow.setHPF(0, lowCutHz, samplingRate);
+    bandHighAndLow.setLPF(1, lowCutHz, samplingRate, 1);
+    bandHighAndLow.mute();
+
+    bpDelay.setDelay(static_cast<uint32_t>(samplingRate / bpDelayDivisor));
+    lpDelay.setDelay(static_cast<uint32_t>(samplingRate / lpDelayDivisor));
+}
+
+template <typename Frames>
+void HiFi::process(Frames samples, uint32_t frames) {
+    // Working copies keep the filter state in registers, stores to the float spans could alias the members
+    NOrderBW<3, QuadLanes> front = highAndBandLow;
+    NOrderBW<3, QuadLanes> back = bandHighAndLow;
+    const float bandGain = gain;
+    const float hpWeight = hpMix;
+    const float bpWeight = bpMix;
+
+    uint32_t offset = 0;
+    while (offset < frames) {
+        // Both lines advance together, each segment stays clear of their wrap points
+        const uint32_t count = std::min({frames - offset, bpDelay.span(), lpDelay.span()});
+        const Frames block = samples.advance(offset);
+        float* bpWrite = bpDelay.writeSpan();
+        float* lpWrite = lpDelay.writeSpan();
+        // A tap never reads ahead of the frame being written, short delays read back frames finished
+        // earlier in the segment
+        const float* bpRead = bpDelay.readSpan();
+        const float* lpRead = lpDelay.readSpan();
+
+        // Second cascade and mix of frame i, split holds the first cascade's output for input x
+        const auto finish = [&](uint32_t i, QuadLanes split, StereoLanes x) {
+            const uint32_t ring = i * 2;
+            const QuadLanes bands = back.process(QuadLanes{split[2], split[3], x[0], x[1]});
+            bpWrite[ring] = bands[0];
+            bpWrite[ring + 1] = bands[1];
+            lpWrite[ring] = bands[2];
+            lpWrite[ring + 1] = bands[3];
+            const StereoLanes hp = {split[0], split[1]};
+            // Intentionally keep LP unscaled so low/mid body stays natural while HP/BP bands are enhanced.
+            const StereoLanes out = hp * bandGain * hpWeight + StereoLanes{bpRead[ring], bpRead[ring + 1]} * bandGain * bpWeight + StereoLanes{lpRead[ring], lpRead[ring + 1]};
+            block.at(0, i) = out[0];
+            block.at(1, i) = out[1];
+        };
+
+        // The first cascade runs one frame ahead of the second so the two dependency chains overlap
+        StereoLanes pending = {block.at(0, 0), block.at(1, 0)};
+        QuadLanes pendingSplit = front.process(QuadLanes{pending[0], pending[1], pending[0], pending[1]});
+        for (uint32_t i = 1; i < count; ++i) {
+            const StereoLanes x = {block.at(0, i), block.at(1, i)};
+            const QuadLanes split = front.process(QuadLanes{x[0], x[1], x[0], x[1]});
+            finish(i - 1, pendingSplit, pending);
+            pending = x;
+            pendingSplit = split;
+        }
+        finish(count - 1, pendingSplit, pending);
 
-    for (uint32_t i = 0; i < frames * 2; ++i) {
-        const int ch = static_cast<int>(i % 2);
-        const float x = samples[i];
-        const float lp = filters[ch].lowpass.process(x);
-        const float hp = filters[ch].highpass.process(x);
-        const float bp = filters[ch].bandpass.process(x);
-        samples[i] = hp;
-        lpWrite[i] = lp;
-        bpWrite[i] = bp;
+        bpDelay.advance(count);
+        lpDelay.advance(count);
+        offset += count;
     }
 
-    float* bpRead = bpBuffer.getBuffer();
-    float* lpRead = lpBuffer.getBuffer();
-    for (uint32_t i = 0; i < frames * 2; ++i) {
-        const float hp = samples[i] * gain * hpMix;
-        const float bp = bpRead[i] * gain * bpMix;
-        // Intentionally keep LP unscaled so low/mid body stays natural while HP/BP bands are enhanced.
-        samples[i] = hp + bp + lpRead[i];
-    }
+    highAndBandLow = front;
+    bandHighAndLow = back;
+}
 
-    bpBuffer.popSamples(frames);
-    lpBuffer.popSamples(frames);
+std::complex<double> HiFi::response(std::complex<double> zInv) const {
+    // LP and BP leave through the delay lines set to samplingRate / divisor frames
+    const double phi = std::arg(zInv);
+    const std::complex<double> hp = highAndBandLow.response(0, zInv);
+    const std::complex<double> bp = highAndBandLow.response(1, zInv) * bandHighAndLow.response(0, zInv) * std::polar(1.0, phi * static_cast<double>(bpDelay.delayFrames()));
+    const std::complex<double> lp = bandHighAndLow.response(1, zInv) * std::polar(1.0, phi * static_cast<double>(lpDelay.delayFrames()));
+    return hp * static_cast<double>(gain * hpMix) + bp * static_cast<double>(gain * bpMix) + lp;
 }
 
 void ClarityProcessor::setSamplingRate(uint32_t sr) {
@@ -338,10 +328,8 @@ void ClarityProcessor::setOzoneFreqHz(int hz) {
         return;
     }
     ozoneFreqHz = hz;
-    for (auto& s : shelf) {
-        s.setFrequency(static_cast<float>(hz));
-        s.setSamplingRate(samplingRate);
-    }
+    shelf.setFrequency(static_cast<float>(hz));
+    shelf.setSamplingRate(samplingRate);
 }
 
 void ClarityProcessor::setXhifiParams(int lowCutHz, int highCutHz, float hpMix, float bpMix, int bpDelayDivisor, int lpDelayDivisor) {
@@ -357,10 +345,8 @@ void ClarityProcessor::reset() {
     natural.setSamplingRate(samplingRate);
     natural.reset();
     syncFilterGain();
-    for (auto& s : shelf) {
-        s.setFrequency(static_cast<float>(ozoneFreqHz));
-        s.setSamplingRate(samplingRate);
-    }
+    shelf.setFrequency(static_cast<float>(ozoneFreqHz));
+    shelf.setSamplingRate(samplingRate);
     xhifi.setSamplingRate(samplingRate);
     xhifi.reset();
     safetyEnv = 0.0f;
@@ -368,21 +354,18 @@ void ClarityProcessor::reset() {
 
 void ClarityProcessor::syncFilterGain() {
     natural.setGain(gain);
-    shelf[0].setGainLinear(gain + 1.0f);
-    shelf[1].setGainLinear(gain + 1.0f);
+    shelf.setGainLinear(gain + 1.0f);
     xhifi.setGainLinear(gain + 1.0f);
 }
 
-void ClarityProcessor::applyMode(float* samples, uint32_t frames) {
+template <typename Frames>
+void ClarityProcessor::applyMode(Frames samples, uint32_t frames) {
     switch (mode) {
         case Mode::NATURAL:
             natural.process(samples, frames);
             break;
         case Mode::OZONE:
-            for (uint32_t i = 0; i < frames * 2; i += 2) {
-                samples[i] = shelf[0].process(samples[i]);
-                samples[i + 1] = shelf[1].process(samples[i + 1]);
-            }
+            shelf.process(samples, frames);
             break;
         case Mode::XHIFI:
             xhifi.process(samples, frames);
@@ -401,23 +384,68 @@ void ClarityProcessor::applyMode(float* samples, uint32_t frames) {
     }
 }
 
-void ClarityProcessor::applyPostGainAndSafety(float* samples, uint32_t frames) {
+template <typename Frames>
+void ClarityProcessor::applyPostGainAndSafety(Frames samples, uint32_t frames) {
     const bool applyPostGain = std::fabs(postGainLinear - 1.0f) > 1e-7f;
     if (!applyPostGain && !safetyEnabled) {
         return;
     }
 
-    for (uint32_t i = 0; i < frames * 2; ++i) {
-        float x = applyPostGain ? (samples[i] * postGainLinear) : samples[i];
-        if (safetyEnabled) {
-            const float absx = std::fabs(x);
-            safetyEnv = std::max(absx, safetyEnv * safetyReleaseCoef);
-            const float threshold = std::max(1e-6f, safetyThresholdLinear);
-            if (safetyEnv > threshold) {
-                x *= threshold / safetyEnv;
+    if (!safetyEnabled) {
+        for (uint32_t i = 0; i < frames; ++i) {
+            samples.at(0, i) *= postGainLinear;
+            samples.at(1, i) *= postGainLinear;
+        }
+        return;
+    }
+
+    // While the envelope is at or below the threshold only a sample above it can push the envelope past,
+    // and that sample sets the envelope to its own level. A chunk entered below the threshold without such
+    // a sample therefore leaves the output untouched, and the envelope carried out of it cannot influence
+    // later samples as long as it stays at or below the threshold (setSafety clears it on any change).
+    // The envelope is shared by both channels and follows the samples in interleaved order.
+    const float threshold = std::max(1e-6f, safetyThresholdLinear);
+    float envelope[kSafetyChunkFrames * 2];
+    for (uint32_t offset = 0; offset < frames; offset += kSafetyChunkFrames) {
+        const uint32_t n = std::min(kSafetyChunkFrames, frames - offset);
+        const Frames chunk = samples.advance(offset);
+
+        if (applyPostGain) {
+            for (uint32_t i = 0; i < n; ++i) {
+                chunk.at(0, i) *= postGainLinear;
+                chunk.at(1, i) *= postGainLinear;
+            }
+        }
+
+        if (safetyEnv <= threshold) {
+            // NaN fails the comparison and takes the limiter path like any sample above the threshold
+            bool below = true;
+            for (uint32_t i = 0; i < n; ++i) {
+                below &= std::fabs(chunk.at(0, i)) <= threshold;
+                below &= std::fabs(chunk.at(1, i)) <= threshold;
+            }
+            if (below) {
+                safetyEnv *= std::pow(safetyReleaseCoef, static_cast<float>(n * 2));
+                continue;
+            }
+        }
+
+        // Only the envelope recursion is serial, gain reduction runs over the chunk afterwards
+        float env = safetyEnv;
+        for (uint32_t i = 0; i < n; ++i) {
+            env = std::max(std::fabs(chunk.at(0, i)), env * safetyReleaseCoef);
+            envelope[i * 2] = env;
+            env = std::max(std::fabs(chunk.at(1, i)), env * safetyReleaseCoef);
+            envelope[i * 2 + 1] = env;
+        }
+        safetyEnv = env;
+        for (uint32_t i = 0; i < n; ++i) {
+            for (int ch = 0; ch < 2; ++ch) {
+                float& sample = chunk.at(ch, i);
+                const float level = envelope[i * 2 + ch];
+                sample = level > threshold ? sample * (threshold / level) : sample;
             }
         }
-        samples[i] = x;
     }
 }
 
@@ -427,10 +455,34 @@ void ClarityProcessor::updateSafetyReleaseCoef() {
     safetyReleaseCoef = std::exp(-1.0f / (releaseSeconds * sr));
 }
 
+std::complex<double> ClarityProcessor::frequencyResponse(double frequencyHz) const {
+    if (!enabled) return 1.0;
+    const double omega = (2.0 * PI * frequencyHz) / static_cast<double>(std::max<uint32_t>(1, samplingRate));
+    const std::complex<double> zInv = std::polar(1.0, -omega);
+    std::complex<double> h;
+    switch (mode) {
+        case Mode::OZONE: h = shelf.response(zInv); break;
+        case Mode::XHIFI: h = xhifi.response(zInv); break;
+        default: h = natural.response(zInv); break;
+    }
+    const bool applyPostGain = std::fabs(postGainLinear - 1.0f) > 1e-7f;
+    return applyPostGain ? h * static_cast<double>(postGainLinear) : h;
+}
+
+template <typename Frames>
+void ClarityProcessor::processBlock(Frames block, uint32_t frames) {
+    applyMode(block, frames);
+    applyPostGainAndSafety(block, frames);
+}
+
 void ClarityProcessor::process(float* samples, uint32_t frames) {
     if (!enabled || samples == nullptr || frames == 0) return;
-    applyMode(samples, frames);
-    applyPostGainAndSafety(samples, frames);
+    processBlock(InterleavedFrames{samples}, frames);
+}
+
+void ClarityProcessor::process(float* const* channels, uint32_t frames) {
+    if (!enabled || channels == nullptr || frames == 0) return;
+    processBlock(PlanarFrames{{channels[0], channels[1]}}, frames);
 }
 
 } // namespace clarity
@@ -1,8 +1,11 @@
 #pragma once
 
+#include <complex>
 #include <cstdint>
 #include <vector>
 
+#include "../stereobiquad/StereoBiquad.h"
+
 namespace clarity {
 
 constexpr uint32_t DEFAULT_SR = 44100;
@@ -13,6 +16,19 @@ enum class Mode {
     XHIFI = 2,
 };
 
+// Addressing of a stereo block, interleaved as the core hands it over or planar as the wrapper keeps it
+struct InterleavedFrames {
+    float* samples;
+    float& at(int channel, uint32_t frame) const { return samples[static_cast<size_t>(frame) * 2 + channel]; }
+    InterleavedFrames advance(uint32_t frames) const { return {samples + static_cast<size_t>(frames) * 2}; }
+};
+
+struct PlanarFrames {
+    float* channels[2];
+    float& at(int channel, uint32_t frame) const { return channels[channel][frame]; }
+    PlanarFrames advance(uint32_t frames) const { return {{channels[0] + frames, channels[1] + frames}}; }
+};
+
 class IIR1 {
 public:
     float b0 = 0.0f;
@@ -24,45 +40,99 @@ public:
     void setLPF_BW(float frequency, uint32_t samplingRate);
     void setHPF_BW(float frequency, uint32_t samplingRate);
     float process(float sample);
+    // Transfer function at zInv = e^-jw
+    std::complex<double> response(std::complex<double> zInv) const;
 };
 
-class NOrderBW_LH {
-public:
-    explicit NOrderBW_LH(uint32_t order);
-    void mute();
-    void setLPF(float frequency, uint32_t samplingRate);
-    void setHPF(float frequency, uint32_t samplingRate);
-    float process(float sample);
-
-private:
-    std::vector<IIR1> filters;
-};
+// Both channels of a stereo frame, lane 0 left and lane 1 right
+using StereoLanes = stereobiquad::Lanes<float>::Vec;
+// Two stereo frames of parallel filters, lanes 0-1 and 2-3
+typedef float QuadLanes __attribute__((vector_size(16)));
 
-class NOrderBW_BP {
+// Order first-order sections in series over the lanes of V with the operation order of IIR1::process.
+// Each stereo pair of lanes has its own coefficients, so a QuadLanes cascade runs two stereo filters.
+// A pair may use fewer sections than Order, the remaining ones pass its samples through.
+template <uint32_t Order, typename V>
+class NOrderBW {
 public:
-    explicit NOrderBW_BP(uint32_t order);
-    void mute();
-    void setBPF(float lowCut, float highCut, uint32_t samplingRate);
-    float process(float sample);
+    void mute() {
+        for (auto& s : state) s = V{};
+    }
+    void setLPF(uint32_t pair, float frequency, uint32_t samplingRate, uint32_t sections = Order) {
+        IIR1 design;
+        design.setLPF_BW(frequency, samplingRate);
+        setPair(pair, design, sections);
+    }
+    void setHPF(uint32_t pair, float frequency, uint32_t samplingRate, uint32_t sections = Order) {
+        IIR1 design;
+        design.setHPF_BW(frequency, samplingRate);
+        setPair(pair, design, sections);
+    }
+    V process(V sample) {
+        for (uint32_t i = 0; i < Order; ++i) {
+            const V hist = sample * b1[i];
+            sample = state[i] + sample * b0[i];
+            state[i] = sample * a1[i] + hist;
+        }
+        return sample;
+    }
+    std::complex<double> response(uint32_t pair, std::complex<double> zInv) const {
+        std::complex<double> h = 1.0;
+        for (uint32_t i = 0; i < Order; ++i) {
+            IIR1 design;
+            design.b0 = b0[i][pair * 2];
+            design.b1 = b1[i][pair * 2];
+            design.a1 = a1[i][pair * 2];
+            h *= design.response(zInv);
+        }
+        return h;
+    }
 
 private:
-    std::vector<IIR1> lowpass;
-    std::vector<IIR1> highpass;
+    void setPair(uint32_t pair, const IIR1& design, uint32_t sections) {
+        for (uint32_t i = 0; i < Order; ++i) {
+            const bool active = i < sections;
+            for (uint32_t lane = pair * 2; lane < pair * 2 + 2; ++lane) {
+                b0[i][lane] = active ? design.b0 : 1.0f;
+                b1[i][lane] = active ? design.b1 : 0.0f;
+                a1[i][lane] = active ? design.a1 : 0.0f;
+            }
+        }
+    }
+
+    V b0[Order] = {};
+    V b1[Order] = {};
+    V a1[Order] = {};
+    V state[Order] = {};
 };
 
-class WaveBuffer {
+// Fixed delay over a preallocated power-of-two ring of interleaved stereo frames. Each step exposes a
+// write span and a read span at the delay that are both contiguous, so a block is processed as a few
+// plain loops without moving the delayed contents.
+class StereoDelayLine {
 public:
-    WaveBuffer(uint32_t channels, uint32_t length);
-    void reset();
-    float* pushZerosGetBuffer(uint32_t frames);
-    void pushZeros(uint32_t frames);
-    float* getBuffer() { return buffer.data(); }
-    void popSamples(uint32_t frames);
+    StereoDelayLine();
+    // Clears the ring, delays above kMaxDelayFrames are clamped
+    void setDelay(uint32_t frames);
+    uint32_t delayFrames() const { return delay; }
+    void clear();
+    // Frames that can be written and read from the current position without wrapping either span
+    uint32_t span() const;
+    float* writeSpan() { return samples.data() + static_cast<size_t>(writeIndex & mask) * 2; }
+    // Frames written delay frames earlier, only valid after the same frames were written
+    const float* readSpan() const { return samples.data() + static_cast<size_t>((writeIndex - delay) & mask) * 2; }
+    void advance(uint32_t frames) { writeIndex += frames; }
+
+    // Covers the XHIFI divisors down to 47 at 192 kHz, the UI keeps them at 80 and above
+    static constexpr uint32_t kCapacityFrames = 8192;
+    static constexpr uint32_t kMaxDelayFrames = kCapacityFrames / 2;
 
 private:
-    std::vector<float> buffer;
-    uint32_t channels = 2;
-    uint32_t index = 0;
+    static constexpr uint32_t mask = kCapacityFrames - 1;
+
+    std::vector<float> samples;
+    uint32_t delay = 0;
+    uint32_t writeIndex = 0;
 };
 
 class NoiseSharpening {
@@ -71,7 +141,9 @@ public:
     void setGain(float gain);
     void setNyquistOffset(float hz);
     void reset();
-    void process(float* buffer, uint32_t frames);
+    template <typename Frames>
+    void process(Frames block, uint32_t frames);
+    std::complex<double> response(std::complex<double> zInv) const;
 
 private:
     IIR1 filters[2];
@@ -81,24 +153,24 @@ private:
     float nyquistOffsetHz = 1000.0f;
 };
 
+// Both channels in one float section, the shelf corner stays within 2 kHz to 16 kHz
 class HighShelf {
 public:
     void setFrequency(float freq) { frequency = freq; }
     void setGainLinear(float gain);
     void setSamplingRate(uint32_t samplingRate);
-    float process(float sample);
+    void process(InterleavedFrames block, uint32_t frames);
+    void process(PlanarFrames block, uint32_t frames);
+    std::complex<double> response(std::complex<double> zInv) const { return filter.response(zInv); }
 
 private:
     float frequency = 8250.0f;
     double gainDb = 0.0;
-    double x1 = 0.0, x2 = 0.0, y1 = 0.0, y2 = 0.0;
-    double b0 = 0.0, b1 = 0.0, b2 = 0.0;
-    double a0 = 1.0, a1 = 0.0, a2 = 0.0;
+    stereobiquad::StereoBiquad<float> filter;
 };
 
 class HiFi {
 public:
-    HiFi();
     void setSamplingRate(uint32_t samplingRate);
     void setGainLinear(float gain);
     void setLowCutHz(float hz);
@@ -108,17 +180,18 @@ public:
     void setBpDelayDivisor(int divisor);
     void setLpDelayDivisor(int divisor);
     void reset();
-    void process(float* samples, uint32_t frames);
+    template <typename Frames>
+    void process(Frames block, uint32_t frames);
+    std::complex<double> response(std::complex<double> zInv) const;
 
 private:
-    WaveBuffer bpBuffer;
-    WaveBuffer lpBuffer;
-    struct ChannelFilters {
-        NOrderBW_LH lowpass;
-        NOrderBW_LH highpass;
-        NOrderBW_BP bandpass;
-        ChannelFilters() : lowpass(1), highpass(3), bandpass(3) {}
-    } filters[2];
+    StereoDelayLine bpDelay;
+    StereoDelayLine lpDelay;
+    // All three bands in two passes: pair 0 of the first is the 3rd order high-pass, pair 1 the low-pass half
+    // of the band-pass. The second runs the high-pass half of the band-pass in pair 0 and the 1st order
+    // low-pass in pair 1, both fed by the input.
+    NOrderBW<3, QuadLanes> highAndBandLow;
+    NOrderBW<3, QuadLanes> bandHighAndLow;
 
     float gain = 1.0f;
     uint32_t samplingRate = DEFAULT_SR;
@@ -143,16 +216,29 @@ public:
     void setOzoneFreqHz(int hz);
     void setXhifiParams(int lowCutHz, int highCutHz, float hpMix, float bpMix, int bpDelayDivisor, int lpDelayDivisor);
     void reset();
+    // Interleaved stereo block in place, the layout the core's adapter uses
     void process(float* samples, uint32_t frames);
+    // Planar stereo block in place, channels[0] left and channels[1] right
+    void process(float* const* channels, uint32_t frames);
+    // Response of the active mode and post gain at frequencyHz, identical for both channels.
+    // The safety limiter is level dependent and not part of it.
+    std::complex<double> frequencyResponse(double frequencyHz) const;
 
 private:
-    void applyMode(float* samples, uint32_t frames);
-    void applyPostGainAndSafety(float* samples, uint32_t frames);
+    template <typename Frames>
+    void processBlock(Frames block, uint32_t frames);
+    template <typename Frames>
+    void applyMode(Frames block, uint32_t frames);
+    template <typename Frames>
+    void applyPostGainAndSafety(Frames block, uint32_t frames);
     void updateSafetyReleaseCoef();
+
+    // Frames per safety prescan, the unit that either bypasses the limiter or runs it
+    static constexpr uint32_t kSafetyChunkFrames = 128;
     void syncFilterGain();
 
     NoiseSharpening natural;
-    HighShelf shelf[2];
+    HighShelf shelf;
     HiFi xhifi;
 
     bool enabled = false;
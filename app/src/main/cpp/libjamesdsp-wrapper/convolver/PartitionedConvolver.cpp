@@ -0,0 +1,482 @@
+#include "PartitionedConvolver.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+
+#if defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace convolver {
+
+static inline int64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static inline void smooth(std::atomic<float>& average, float sample, float weight) {
+    const float previous = average.load(std::memory_order_relaxed);
+    average.store(previous == 0.0f ? sample : previous + (sample - previous) * weight, std::memory_order_relaxed);
+}
+
+Fft::Fft(uint32_t size) : n(size), bitReverse(size), twiddle(size / 2) {
+    uint32_t bits = 0;
+    while ((1u << bits) < size) {
+        ++bits;
+    }
+    for (uint32_t i = 0; i < size; ++i) {
+        uint32_t reversed = 0;
+        for (uint32_t b = 0; b < bits; ++b) {
+            reversed |= ((i >> b) & 1u) << (bits - 1 - b);
+        }
+        bitReverse[i] = reversed;
+    }
+    for (uint32_t k = 0; k < size / 2; ++k) {
+        const double phase = -2.0 * M_PI * static_cast<double>(k) / static_cast<double>(size);
+        twiddle[k] = std::complex<float>(static_cast<float>(std::cos(phase)), static_cast<float>(std::sin(phase)));
+    }
+}
+
+void Fft::transform(std::complex<float>* data, bool inverse) const {
+    for (uint32_t i = 0; i < n; ++i) {
+        const uint32_t j = bitReverse[i];
+        if (i < j) {
+            std::swap(data[i], data[j]);
+        }
+    }
+    // Butterflies spelled out in real arithmetic, std::complex multiplication goes through the Annex G
+    // NaN handling unless fast-math is on
+    const float sign = inverse ? -1.0f : 1.0f;
+    for (uint32_t length = 2; length <= n; length <<= 1) {
+        const uint32_t half = length / 2;
+        const uint32_t step = n / length;
+        for (uint32_t start = 0; start < n; start += length) {
+            std::complex<float>* a = data + start;
+            std::complex<float>* b = a + half;
+            for (uint32_t k = 0; k < half; ++k) {
+                const float wr = twiddle[k * step].real();
+                const float wi = sign * twiddle[k * step].imag();
+                const float br = b[k].real() * wr - b[k].imag() * wi;
+                const float bi = b[k].real() * wi + b[k].imag() * wr;
+                const float ar = a[k].real();
+                const float ai = a[k].imag();
+                a[k] = std::complex<float>(ar + br, ai + bi);
+                b[k] = std::complex<float>(ar - br, ai - bi);
+            }
+        }
+    }
+}
+
+bool PathMatrix::assign(int channels) {
+    switch (channels) {
+        case 1:
+            index[0][0] = 0;
+            index[1][1] = 0;
+            responses = 1;
+            return true;
+        case 2:
+            index[0][0] = 0;
+            index[1][1] = 1;
+            responses = 2;
+            return true;
+        case 4:
+            index[0][0] = 0;
+            index[1][0] = 1;
+            index[0][1] = 2;
+            index[1][1] = 3;
+            responses = 4;
+            return true;
+        default:
+            return false;
+    }
+}
+
+static inline void multiplyAccumulate(float* __restrict accRe, float* __restrict accIm,
+                                      const float* __restrict xRe, const float* __restrict xIm,
+                                      const float* __restrict hRe, const float* __restrict hIm, uint32_t bins) {
+    for (uint32_t k = 0; k < bins; ++k) {
+        accRe[k] += xRe[k] * hRe[k] - xIm[k] * hIm[k];
+        accIm[k] += xRe[k] * hIm[k] + xIm[k] * hRe[k];
+    }
+}
+
+// IEEE binary16 bits of value, rounded to nearest even. |value| stays below the binary16 range here.
+static uint16_t halfFromFloat(float value) {
+    uint32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000u);
+    bits &= 0x7fffffffu;
+    if (bits < 0x38800000u) {
+        // Below the smallest normal binary16, the mantissa counts units of 2^-24
+        return static_cast<uint16_t>(sign | static_cast<uint16_t>(std::nearbyint(std::fabs(value) * 16777216.0f)));
+    }
+    // Rebias the exponent from 127 to 15 and round away the 13 low mantissa bits, a carry moves into the exponent
+    uint32_t half = (bits - 0x38000000u) >> 13;
+    const uint32_t rest = bits & 0x1fffu;
+    if (rest > 0x1000u || (rest == 0x1000u && (half & 1u) != 0)) {
+        ++half;
+    }
+    return static_cast<uint16_t>(sign | half);
+}
+
+// Half precision spectra times scale. bins may be rounded up to a multiple of four, the spectra are padded.
+static inline void multiplyAccumulateHalf(float* __restrict accRe, float* __restrict accIm,
+                                          const float* __restrict xRe, const float* __restrict xIm,
+                                          const uint16_t* __restrict hRe, const uint16_t* __restrict hIm,
+                                          float scale, uint32_t bins) {
+#if defined(__aarch64__)
+    // fcvtl widens four binary16 values per instruction
+    const float32x4_t s = vdupq_n_f32(scale);
+    for (uint32_t k = 0; k < bins; k += 4) {
+        const float32x4_t hr = vmulq_f32(vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(hRe + k))), s);
+        const float32x4_t hi = vmulq_f32(vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(hIm + k))), s);
+        const float32x4_t xr = vld1q_f32(xRe + k);
+        const float32x4_t xi = vld1q_f32(xIm + k);
+        vst1q_f32(accRe + k, vfmsq_f32(vfmaq_f32(vld1q_f32(accRe + k), xr, hr), xi, hi));
+        vst1q_f32(accIm + k, vfmaq_f32(vfmaq_f32(vld1q_f32(accIm + k), xr, hi), xi, hr));
+    }
+#else
+    // Without conversion instructions in the baseline ISA: the exponent and mantissa bits moved into float
+    // position read as the value times 2^-112, which the scale takes back. Plain integer lanes, so the loop
+    // vectorizes on SSE2 and NEON alike. Exact unless denormals are flushed, which only drops values 2^-29
+    // below the partition's peak.
+    const float expand = scale * 0x1p112f;
+    for (uint32_t k = 0; k < bins; ++k) {
+        const uint32_t reBits = (static_cast<uint32_t>(hRe[k] & 0x7fffu) << 13) | (static_cast<uint32_t>(hRe[k] & 0x8000u) << 16);
+        const uint32_t imBits = (static_cast<uint32_t>(hIm[k] & 0x7fffu) << 13) | (static_cast<uint32_t>(hIm[k] & 0x8000u) << 16);
+        float hr;
+        float hi;
+        std::memcpy(&hr, &reBits, sizeof(hr));
+        std::memcpy(&hi, &imBits, sizeof(hi));
+        hr *= expand;
+        hi *= expand;
+        accRe[k] += xRe[k] * hr - xIm[k] * hi;
+        accIm[k] += xRe[k] * hi + xIm[k] * hr;
+    }
+#endif
+}
+
+UniformSegment::UniformSegment(const float* impulse, int channels, uint32_t impulseFrames, const PathMatrix& paths,
+                               uint32_t offset, uint32_t length, uint32_t blockFrames, SpectrumPrecision precision)
+    : paths(paths),
+      frames(blockFrames),
+      partitions((length + blockFrames - 1) / blockFrames),
+      binStride((blockFrames + 1 + 15) & ~15u),
+      precision(precision),
+      fft(blockFrames * 2) {
+    const uint32_t size = fft.size();
+    const size_t spectrumCount = static_cast<size_t>(paths.responses) * partitions;
+    if (precision == SpectrumPrecision::Half) {
+        halfSpectra.assign(spectrumCount * 2 * binStride, 0);
+        halfScales.assign(spectrumCount, 0.0f);
+    } else {
+        impulseSpectra.assign(spectrumCount * 2 * binStride, 0.0f);
+    }
+    inputSpectra.assign(static_cast<size_t>(2) * partitions * 2 * binStride, 0.0f);
+    accumulator.assign(static_cast<size_t>(2) * 2 * binStride, 0.0f);
+    previous[0].assign(frames, 0.0f);
+    previous[1].assign(frames, 0.0f);
+    work.resize(size);
+
+    // The forward unpacking doubles each input spectrum and the inverse transform is unscaled
+    const float scale = 1.0f / (2.0f * static_cast<float>(size));
+    const uint32_t end = std::min(offset + length, impulseFrames);
+    for (int r = 0; r < paths.responses; ++r) {
+        for (uint32_t q = 0; q < partitions; ++q) {
+            std::fill(work.begin(), work.end(), std::complex<float>());
+            for (uint32_t t = 0; t < frames; ++t) {
+                const uint32_t tap = offset + q * frames + t;
+                if (tap >= end) {
+                    break;
+                }
+                work[t] = std::complex<float>(impulse[static_cast<size_t>(tap) * channels + r] * scale, 0.0f);
+            }
+            fft.forward(work.data());
+            const size_t index = static_cast<size_t>(r) * partitions + q;
+            if (precision == SpectrumPrecision::Half) {
+                // The partition's largest part maps to 2^15, so its quietest bins stay far above the subnormal
+                // range and the relative rounding error is 2^-11 throughout
+                float peak = 0.0f;
+                for (uint32_t k = 0; k <= frames; ++k) {
+                    peak = std::max(peak, std::max(std::fabs(work[k].real()), std::fabs(work[k].imag())));
+                }
+                const float partitionScale = peak > 0.0f ? peak / 32768.0f : 1.0f;
+                uint16_t* h = halfSpectra.data() + index * 2 * binStride;
+                for (uint32_t k = 0; k <= frames; ++k) {
+                    h[k] = halfFromFloat(work[k].real() / partitionScale);
+                    h[binStride + k] = halfFromFloat(work[k].imag() / partitionScale);
+                }
+                halfScales[index] = partitionScale;
+            } else {
+                float* h = spectrum(impulseSpectra, index);
+                for (uint32_t k = 0; k <= frames; ++k) {
+                    h[k] = work[k].real();
+                    h[binStride + k] = work[k].imag();
+                }
+            }
+        }
+    }
+}
+
+size_t UniformSegment::spectrumBytes() const {
+    return impulseSpectra.size() * sizeof(float) + halfSpectra.size() * sizeof(uint16_t) +
+           halfScales.size() * sizeof(float);
+}
+
+void UniformSegment::process(const float* const* input, float* const* output) {
+    const uint32_t size = fft.size();
+    // Overlap-save over the previous and the new block, left in the real and right in the imaginary part
+    for (uint32_t t = 0; t < frames; ++t) {
+        work[t] = std::complex<float>(previous[0][t], previous[1][t]);
+        work[frames + t] = std::complex<float>(input[0][t], input[1][t]);
+    }
+    std::copy(input[0], input[0] + frames, previous[0].begin());
+    std::copy(input[1], input[1] + frames, previous[1].begin());
+    fft.forward(work.data());
+
+    // The delay line runs backwards through its slots, partition q pairs with the input q blocks ago
+    newest = newest == 0 ? partitions - 1 : newest - 1;
+    float* left = spectrum(inputSpectra, newest);
+    float* right = spectrum(inputSpectra, partitions + newest);
+    for (uint32_t k = 0; k <= frames; ++k) {
+        const std::complex<float> a = work[k];
+        const std::complex<float> b = std::conj(work[(size - k) & (size - 1)]);
+        left[k] = a.real() + b.real();
+        left[binStride + k] = a.imag() + b.imag();
+        right[k] = a.imag() - b.imag();
+        right[binStride + k] = b.real() - a.real();
+    }
+
+    const uint32_t bins = frames + 1;
+    std::fill(accumulator.begin(), accumulator.end(), 0.0f);
+    for (uint32_t q = 0; q < partitions; ++q) {
+        const uint32_t slot = (newest + q) % partitions;
+        for (int out = 0; out < 2; ++out) {
+            float* acc = spectrum(accumulator, out);
+            for (int in = 0; in < 2; ++in) {
+                const int r = paths.index[out][in];
+                if (r < 0) {
+                    continue;
+                }
+                const float* x = spectrum(inputSpectra, static_cast<size_t>(in) * partitions + slot);
+                const size_t index = static_cast<size_t>(r) * partitions + q;
+                if (precision == SpectrumPrecision::Half) {
+                    const uint16_t* h = halfSpectrum(index);
+                    multiplyAccumulateHalf(acc, acc + binStride, x, x + binStride, h, h + binStride,
+                                           halfScales[index], (bins + 3) & ~3u);
+                } else {
+                    const float* h = spectrum(impulseSpectra, index);
+                    multiplyAccumulate(acc, acc + binStride, x, x + binStride, h, h + binStride, bins);
+                }
+            }
+        }
+    }
+
+    // Both real outputs through one inverse transform, left + j right with Hermitian halves
+    const float* yl = spectrum(accumulator, 0);
+    const float* yr = spectrum(accumulator, 1);
+    for (uint32_t k = 0; k <= frames; ++k) {
+        work[k] = std::complex<float>(yl[k] - yr[binStride + k], yl[binStride + k] + yr[k]);
+        if (k > 0 && k < frames) {
+            work[size - k] = std::complex<float>(yl[k] + yr[binStride + k], yr[k] - yl[binStride + k]);
+        }
+    }
+    fft.inverse(work.data());
+    for (uint32_t t = 0; t < frames; ++t) {
+        output[0][t] = work[frames + t].real();
+        output[1][t] = work[frames + t].imag();
+    }
+}
+
+bool PartitionedConvolver::load(const float* impulse, int channels, int frames, SpectrumPrecision precision) {
+    if (impulse == nullptr || frames <= 0 || !tails.empty() || !paths.assign(channels)) {
+        return false;
+    }
+    const auto length = static_cast<uint32_t>(frames);
+
+    const uint32_t headLength = std::min(length, kHeadFrames);
+    for (int r = 0; r < paths.responses; ++r) {
+        headTaps[r].assign(kHeadFrames, 0.0f);
+        for (uint32_t k = 0; k < headLength; ++k) {
+            headTaps[r][kHeadFrames - 1 - k] = impulse[static_cast<size_t>(k) * channels + r];
+        }
+    }
+    for (auto& history : line) {
+        history.assign(kHeadFrames - 1 + kHeadFrames, 0.0f);
+    }
+
+    // Near segment up to where the first tail segment starts
+    uint32_t block = kHeadFrames * kGrowth;
+    uint32_t start = std::min(length, 2 * block);
+    if (length > kHeadFrames) {
+        near = std::make_unique<UniformSegment>(impulse, channels, length, paths, kHeadFrames, start - kHeadFrames,
+                                                kHeadFrames);
+        nearOutput[0].assign(kHeadFrames, 0.0f);
+        nearOutput[1].assign(kHeadFrames, 0.0f);
+    }
+
+    while (start < length) {
+        const uint32_t next = block * kGrowth;
+        const uint32_t end = next <= kMaxBlockFrames ? std::min(length, 2 * next) : length;
+        auto tail = std::make_unique<Tail>();
+        tail->segment = std::make_unique<UniformSegment>(impulse, channels, length, paths, start, end - start, block,
+                                                         precision);
+        for (auto& slot : tail->input) {
+            slot[0].assign(block, 0.0f);
+            slot[1].assign(block, 0.0f);
+        }
+        for (auto& slot : tail->output) {
+            slot[0].assign(block, 0.0f);
+            slot[1].assign(block, 0.0f);
+        }
+        tails.push_back(std::move(tail));
+        start = end;
+        block = std::min(next, kMaxBlockFrames);
+    }
+    // Started once every segment is in place
+    for (size_t level = 0; level < tails.size(); ++level) {
+        tails[level]->level = static_cast<int>(level);
+        tails[level]->worker = std::make_unique<parallel::BlockWorker>(runTail, tails[level].get(), lowerPriority);
+    }
+    return true;
+}
+
+size_t PartitionedConvolver::spectrumBytes() const {
+    size_t bytes = near ? near->spectrumBytes() : 0;
+    for (const auto& tail : tails) {
+        bytes += tail->segment->spectrumBytes();
+    }
+    return bytes;
+}
+
+float PartitionedConvolver::workerNsPerFrame() const {
+    float sum = 0.0f;
+    for (const auto& tail : tails) {
+        sum += tail->ns.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+void PartitionedConvolver::process(float* const* channels, uint32_t frames) {
+    const int64_t start = nowNs();
+    for (uint32_t done = 0; done < frames;) {
+        const auto phase = static_cast<uint32_t>(position % kHeadFrames);
+        const uint32_t count = std::min(frames - done, kHeadFrames - phase);
+        processChunk(channels, done, count);
+        done += count;
+    }
+    if (frames > 0) {
+        smooth(callerNs, static_cast<float>(nowNs() - start) / static_cast<float>(frames), kLoadSmoothing);
+    }
+}
+
+void PartitionedConvolver::processChunk(float* const* channels, uint32_t offset, uint32_t frames) {
+    const auto phase = static_cast<uint32_t>(position % kHeadFrames);
+    for (int c = 0; c < 2; ++c) {
+        const float* x = channels[c] + offset;
+        std::copy(x, x + frames, line[c].begin() + (kHeadFrames - 1 + phase));
+        for (auto& tail : tails) {
+            const uint32_t block = tail->segment->blockFrames();
+            const uint64_t index = position / block;
+            std::copy(x, x + frames, tail->input[index & 1][c].begin() + (position % block));
+        }
+    }
+
+    for (int out = 0; out < 2; ++out) {
+        float* y = channels[out] + offset;
+        if (near) {
+            std::copy(nearOutput[out].begin() + phase, nearOutput[out].begin() + phase + frames, y);
+        } else {
+            std::fill(y, y + frames, 0.0f);
+        }
+        for (int in = 0; in < 2; ++in) {
+            const int r = paths.index[out][in];
+            if (r < 0) {
+                continue;
+            }
+            const float* taps = headTaps[r].data();
+            const float* history = line[in].data() + phase;
+            for (uint32_t t = 0; t < frames; ++t) {
+                float sum = 0.0f;
+                for (uint32_t k = 0; k < kHeadFrames; ++k) {
+                    sum += taps[k] * history[t + k];
+                }
+                y[t] += sum;
+            }
+        }
+        // Block k of the input went out at its end, block k - 2 plays now from the slot with the same parity
+        for (auto& tail : tails) {
+            const uint32_t block = tail->segment->blockFrames();
+            const uint64_t index = position / block;
+            const float* source = tail->output[index & 1][out].data() + (position % block);
+            for (uint32_t t = 0; t < frames; ++t) {
+                y[t] += source[t];
+            }
+        }
+    }
+
+    position += frames;
+    if (position % kHeadFrames == 0) {
+        finishHeadBlock();
+    }
+    for (auto& tail : tails) {
+        if (position % tail->segment->blockFrames() == 0) {
+            finishTailBlock(*tail);
+        }
+    }
+}
+
+void PartitionedConvolver::finishHeadBlock() {
+    if (near) {
+        const float* input[2] = {line[0].data() + kHeadFrames - 1, line[1].data() + kHeadFrames - 1};
+        float* output[2] = {nearOutput[0].data(), nearOutput[1].data()};
+        near->process(input, output);
+    }
+    for (auto& history : line) {
+        std::copy(history.begin() + kHeadFrames, history.end(), history.begin());
+    }
+}
+
+void PartitionedConvolver::finishTailBlock(Tail& tail) {
+    const uint64_t blocks = position / tail.segment->blockFrames();
+    tail.worker->submit(blocks);
+    if (blocks < 2) {
+        return;
+    }
+    // Block blocks - 2 plays from here on and was handed over one block period ago
+    if (tail.worker->completed() < blocks - 1) {
+        misses.fetch_add(1, std::memory_order_relaxed);
+        tail.worker->waitFor(blocks - 1);
+    }
+}
+
+void PartitionedConvolver::lowerPriority(void* tail) {
+#ifdef __linux__
+    // Shorter deadlines win when the workers share a core: every level further out runs kNiceStep nicer.
+    // Lowering the own priority needs no permission.
+    const int level = static_cast<Tail*>(tail)->level;
+    setpriority(PRIO_PROCESS, static_cast<id_t>(syscall(SYS_gettid)), level * kNiceStep);
+#else
+    (void)tail;
+#endif
+}
+
+void PartitionedConvolver::runTail(void* context, uint64_t block) {
+    auto* tail = static_cast<Tail*>(context);
+    const uint32_t frames = tail->segment->blockFrames();
+    const int64_t start = nowNs();
+    const float* input[2] = {tail->input[block & 1][0].data(), tail->input[block & 1][1].data()};
+    float* output[2] = {tail->output[block & 1][0].data(), tail->output[block & 1][1].data()};
+    tail->segment->process(input, output);
+    smooth(tail->ns, static_cast<float>(nowNs() - start) / static_cast<float>(frames), kLoadSmoothing);
+}
+
+} // namespace convolver
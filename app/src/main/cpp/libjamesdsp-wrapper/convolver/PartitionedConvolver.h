@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "../parallel/BlockWorker.h"
+
+namespace convolver {
+
+// In place radix-2 complex FFT of a fixed power-of-two size, the inverse is unscaled
+class Fft {
+public:
+    explicit Fft(uint32_t size);
+    uint32_t size() const { return n; }
+    void forward(std::complex<float>* data) const { transform(data, false); }
+    void inverse(std::complex<float>* data) const { transform(data, true); }
+
+private:
+    void transform(std::complex<float>* data, bool inverse) const;
+
+    uint32_t n;
+    std::vector<uint32_t> bitReverse;
+    std::vector<std::complex<float>> twiddle;
+};
+
+// Which impulse response feeds which output from which input, for the 1, 2 and 4 channel layouts
+struct PathMatrix {
+    // Impulse response index per output and input, -1 where the input does not reach the output
+    int index[2][2] = {{-1, -1}, {-1, -1}};
+    int responses = 0;
+
+    // channels 1: one response on both sides. 2: left and right response. 4: left to left, left to right,
+    // right to left and right to right. Other counts return false.
+    bool assign(int channels);
+};
+
+// Storage of impulse response spectra. Half keeps IEEE binary16 values with one float scale per partition and
+// expands them inside the multiply-accumulate, at half the memory and cache traffic of Float.
+enum class SpectrumPrecision {
+    Float,
+    Half
+};
+
+// Uniformly partitioned overlap-save convolution of a stereo signal with the slice [offset, offset + length)
+// of an impulse response, in blocks of blockFrames frames. Both input channels share one complex FFT as real
+// and imaginary part, spectra are kept in split real/imaginary arrays so the multiply-accumulate vectorizes.
+class UniformSegment {
+public:
+    UniformSegment(const float* impulse, int channels, uint32_t impulseFrames, const PathMatrix& paths,
+                   uint32_t offset, uint32_t length, uint32_t blockFrames,
+                   SpectrumPrecision precision = SpectrumPrecision::Float);
+
+    uint32_t blockFrames() const { return frames; }
+    // Bytes held by the impulse response spectra
+    size_t spectrumBytes() const;
+    // Takes the next block of input and writes the segment's output for it, both blockFrames frames
+    void process(const float* const* input, float* const* output);
+
+private:
+    // Real parts of bins 0 .. blockFrames followed by the imaginary parts, each padded to whole cache lines
+    float* spectrum(std::vector<float>& pool, size_t index) { return pool.data() + index * 2 * binStride; }
+    const uint16_t* halfSpectrum(size_t index) const { return halfSpectra.data() + index * 2 * binStride; }
+
+    const PathMatrix paths;
+    const uint32_t frames;
+    const uint32_t partitions;
+    const uint32_t binStride;
+    const SpectrumPrecision precision;
+    Fft fft;
+
+    // Per response and partition, premultiplied by the unpacking and inverse transform scale. Half precision
+    // stores binary16 bits with the partition's float scale next to them instead.
+    std::vector<float> impulseSpectra;
+    std::vector<uint16_t> halfSpectra;
+    std::vector<float> halfScales;
+    // Frequency-domain delay line, per input the spectra of the last partitions blocks
+    std::vector<float> inputSpectra;
+    std::vector<float> accumulator;
+    std::vector<float> previous[2];
+    std::vector<std::complex<float>> work;
+    uint32_t newest = 0;
+};
+
+// Non-uniformly partitioned, zero latency convolver. The first kHeadFrames taps run as a direct FIR and the
+// next partitions as a kHeadFrames block uniform segment, both on the calling thread. Every later segment uses
+// kGrowth times the block size of the one before, starts at twice its own block size and runs on a worker
+// thread of its own. A segment's block is handed over once its input is complete and is due one block period
+// later, so the caller does the same small amount of work on every kHeadFrames frames no matter how long the
+// impulse response is.
+class PartitionedConvolver {
+public:
+    PartitionedConvolver() = default;
+    PartitionedConvolver(const PartitionedConvolver&) = delete;
+    PartitionedConvolver& operator=(const PartitionedConvolver&) = delete;
+
+    // Interleaved impulse response of frames frames with 1, 2 or 4 channels, on a convolver that has not
+    // been loaded yet. Transforms the response and starts the workers, so call it off the audio thread.
+    // precision applies to the worker segments, which hold nearly all of the spectra.
+    bool load(const float* impulse, int channels, int frames,
+              SpectrumPrecision precision = SpectrumPrecision::Float);
+
+    // Planar stereo block in place, channels[0] left and channels[1] right
+    void process(float* const* channels, uint32_t frames);
+
+    // Smoothed time per frame spent on the calling thread and summed over the workers
+    float callerNsPerFrame() const { return callerNs.load(std::memory_order_relaxed); }
+    float workerNsPerFrame() const;
+    // Blocks the caller had to wait for because a worker missed its deadline
+    uint32_t deadlineMisses() const { return misses.load(std::memory_order_relaxed); }
+    size_t spectrumBytes() const;
+
+private:
+    static constexpr uint32_t kHeadFrames = 64;
+    // Block size ratio between neighbouring segments and the largest block size
+    static constexpr uint32_t kGrowth = 8;
+    static constexpr uint32_t kMaxBlockFrames = 32768;
+    static constexpr float kLoadSmoothing = 0.05f;
+    static constexpr int kNiceStep = 2;
+
+    // A segment on its own thread with double-buffered input and output blocks
+    struct Tail {
+        std::unique_ptr<UniformSegment> segment;
+        std::vector<float> input[2][2];
+        std::vector<float> output[2][2];
+        std::atomic<float> ns{0.0f};
+        int level = 0;
+        // Started once every segment is in place, stopped first on destruction
+        std::unique_ptr<parallel::BlockWorker> worker;
+    };
+
+    static void lowerPriority(void* tail);
+    static void runTail(void* tail, uint64_t block);
+    void processChunk(float* const* channels, uint32_t offset, uint32_t frames);
+    void finishHeadBlock();
+    void finishTailBlock(Tail& tail);
+
+    PathMatrix paths;
+    // Head taps per response, reversed
+    std::vector<float> headTaps[4];
+    // Per input the last kHeadFrames - 1 frames of the previous block followed by the current block
+    std::vector<float> line[2];
+    std::unique_ptr<UniformSegment> near;
+    std::vector<float> nearOutput[2];
+    std::vector<std::unique_ptr<Tail>> tails;
+    uint64_t position = 0;
+
+    std::atomic<float> callerNs{0.0f};
+    std::atomic<uint32_t> misses{0};
+};
+
+} // namespace convolver
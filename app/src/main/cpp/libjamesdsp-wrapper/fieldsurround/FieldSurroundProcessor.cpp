@@ -2,125 +2,88 @@
 
 #include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <limits>
 
 namespace fieldsurround {
 
 static constexpr double PI = 3.14159265358979323846;
 
-void TimeConstDelay::setParameters(uint32_t samplingRate, float delaySeconds) {
-    static constexpr float kMaxDelaySeconds = 5.0f;
-    const float safeDelay = std::isfinite(delaySeconds) ? delaySeconds : 0.0f;
-    const float clampedDelay = std::clamp(safeDelay, 0.0f, kMaxDelaySeconds);
+// zInv^samples for zInv on the unit circle
+static std::complex<double> delayResponse(std::complex<double> zInv, uint32_t samples) {
+    return std::polar(1.0, std::arg(zInv) * static_cast<double>(samples));
+}
 
-    sampleCount = 1;
-    if (samplingRate > 0) {
-        sampleCount = static_cast<uint32_t>(static_cast<double>(samplingRate) * static_cast<double>(clampedDelay));
-        if (sampleCount == 0) {
-            sampleCount = 1;
-        }
+TimeConstDelay::TimeConstDelay() {
+    const auto maxCount = static_cast<uint32_t>(static_cast<double>(kMaxSamplingRate) * static_cast<double>(kMaxDelaySeconds));
+    uint32_t capacity = 1;
+    while (capacity < maxCount) {
+        capacity <<= 1;
     }
-
-    samples.assign(sampleCount, 0.0f);
-    offset = 0;
+    samples.assign(capacity, 0.0f);
+    mask = capacity - 1;
 }
 
-float TimeConstDelay::processSample(float sample) {
-    if (samples.empty()) {
-        return sample;
-    }
+void TimeConstDelay::setParameters(uint32_t samplingRate, float delaySeconds) {
+    const float safeDelay = std::isfinite(delaySeconds) ? delaySeconds : 0.0f;
+    const float clampedDelay = std::clamp(safeDelay, 0.0f, kMaxDelaySeconds);
 
-    uint32_t wrapCount = sampleCount;
-    if (wrapCount == 0 || wrapCount > samples.size()) {
-        wrapCount = static_cast<uint32_t>(samples.size());
-    }
-    if (wrapCount == 0) {
-        return sample;
+    uint32_t count = 1;
+    if (samplingRate > 0) {
+        count = static_cast<uint32_t>(static_cast<double>(samplingRate) * static_cast<double>(clampedDelay));
+        // Rates above kMaxSamplingRate get the longest delay the ring holds
+        count = std::clamp<uint32_t>(count, 1, mask + 1);
     }
 
-    if (offset >= wrapCount) {
-        offset = 0;
+    if (count == targetCount) {
+        return;
     }
-
-    const float out = samples[offset];
-    samples[offset] = sample;
-    ++offset;
-    if (offset >= wrapCount) {
-        offset = 0;
+    // A retarget during a fade continues from the tap that dominates the output
+    if (sampleCount != targetCount && fadePosition * 2 >= kFadeFrames) {
+        sampleCount = targetCount;
     }
-    return out;
-}
-
-Biquad::Biquad() {
-    setCoeffs(1.0, 0.0, 0.0, 1.0, 0.0, 0.0);
+    targetCount = count;
+    fadePosition = 0;
 }
 
-void Biquad::reset() {
-    x1 = 0.0;
-    x2 = 0.0;
-    y1 = 0.0;
-    y2 = 0.0;
+void TimeConstDelay::clear() {
+    std::fill(samples.begin(), samples.end(), 0.0f);
+    sampleCount = targetCount;
+    fadePosition = 0;
+    writeIndex = 0;
 }
 
-float Biquad::processSample(float sample) {
-    const double out = sample * b0 + x1 * b1 + x2 * b2 + y1 * a1 + y2 * a2;
-    x2 = x1;
-    x1 = sample;
-    y2 = y1;
-    y1 = out;
-    return static_cast<float>(out);
+void TimeConstDelay::readTap(float* output, uint32_t frames, uint32_t count) const {
+    const uint32_t start = (writeIndex - count) & mask;
+    const uint32_t first = std::min(frames, mask + 1 - start);
+    std::memcpy(output, samples.data() + start, first * sizeof(float));
+    std::memcpy(output + first, samples.data(), (frames - first) * sizeof(float));
 }
 
-void Biquad::setCoeffs(double a0, double aa1, double aa2, double bb0, double bb1, double bb2) {
-    if (std::fabs(a0) < 1.0e-12) {
-        x1 = 0.0;
-        x2 = 0.0;
-        y1 = 0.0;
-        y2 = 0.0;
-        a1 = 0.0;
-        a2 = 0.0;
-        b0 = 1.0;
-        b1 = 0.0;
-        b2 = 0.0;
+void TimeConstDelay::read(float* output, uint32_t frames) {
+    readTap(output, frames, sampleCount);
+    if (sampleCount == targetCount) {
         return;
     }
 
-    x1 = 0.0;
-    x2 = 0.0;
-    y1 = 0.0;
-    y2 = 0.0;
-
-    a1 = -(aa1 / a0);
-    a2 = -(aa2 / a0);
-    b0 = bb0 / a0;
-    b1 = bb1 / a0;
-    b2 = bb2 / a0;
-}
-
-void Biquad::setHighPassParameter(float frequency, uint32_t samplingRate, double dbGain, float qFactor) {
-    if (samplingRate == 0) {
-        // Keep the filter neutral if sampling rate is unavailable.
-        setCoeffs(1.0, 0.0, 0.0, 1.0, 0.0, 0.0);
-        return;
+    for (uint32_t i = 0; i < frames; ++i) {
+        const float next = samples[(writeIndex + i - targetCount) & mask];
+        const float t = static_cast<float>(std::min(fadePosition + i, kFadeFrames)) / static_cast<float>(kFadeFrames);
+        output[i] += t * (next - output[i]);
     }
+    fadePosition += frames;
+    if (fadePosition >= kFadeFrames) {
+        sampleCount = targetCount;
+        fadePosition = 0;
+    }
+}
 
-    const double omega = (2.0 * PI * static_cast<double>(frequency)) / static_cast<double>(samplingRate);
-    const double sinOmega = std::sin(omega);
-    const double cosOmega = std::cos(omega);
-
-    const double A = std::pow(10.0, dbGain / 40.0);
-    const double sqrtA = std::sqrt(A);
-    const double z = sinOmega / 2.0 * std::sqrt((1.0 / A + A) * (1.0 / static_cast<double>(qFactor) - 1.0) + 2.0);
-
-    const double a0 = (A + 1.0) - (A - 1.0) * cosOmega + 2.0 * sqrtA * z;
-    const double a1 = 2.0 * ((A - 1.0) - (A + 1.0) * cosOmega);
-    const double a2 = (A + 1.0) - (A - 1.0) * cosOmega - 2.0 * sqrtA * z;
-    // Note: b-coefficients include omega scaling to match ViPER behavior.
-    const double b0 = ((A + 1.0) + (A - 1.0) * cosOmega + 2.0 * sqrtA * z) * A * omega;
-    const double b1 = -2.0 * A * ((A - 1.0) + (A + 1.0) * cosOmega) * omega;
-    const double b2 = ((A + 1.0) + (A - 1.0) * cosOmega - 2.0 * sqrtA * z) * A * omega;
-
-    setCoeffs(a0, a1, a2, b0, b1, b2);
+void TimeConstDelay::write(const float* input, uint32_t frames) {
+    const uint32_t start = writeIndex & mask;
+    const uint32_t first = std::min(frames, mask + 1 - start);
+    std::memcpy(samples.data() + start, input, first * sizeof(float));
+    std::memcpy(samples.data(), input + first, (frames - first) * sizeof(float));
+    writeIndex += frames;
 }
 
 void PhaseShifter::setCoefficient(float value) {
@@ -139,6 +102,11 @@ void PhaseShifter::reset() {
     y1 = 0.0f;
 }
 
+std::complex<double> PhaseShifter::response(std::complex<double> zInv) const {
+    const double c = static_cast<double>(coefficient);
+    return (-c + zInv) / (1.0 - c * zInv);
+}
+
 void Stereo3DSurround::setStereoWiden(float value) {
     stereoWiden = value;
     configureVariables();
@@ -163,22 +131,35 @@ void Stereo3DSurround::configureVariables() {
     coeffRight = tmp * y;
 }
 
-void Stereo3DSurround::process(float* samples, uint32_t frames) {
-    if (samples == nullptr || frames == 0) {
+void Stereo3DSurround::process(float* left, float* right, uint32_t frames) {
+    if (left == nullptr || right == nullptr || frames == 0) {
         return;
     }
 
     for (uint32_t i = 0; i < frames; ++i) {
-        const uint32_t index = i * 2;
-        const float inL = samples[index];
-        const float inR = samples[index + 1];
-        const float a = coeffLeft * (inL + inR);
-        const float b = coeffRight * (inR - inL);
-        samples[index] = a - b;
-        samples[index + 1] = a + b;
+        processFrame(left[i], right[i]);
     }
 }
 
+void Stereo3DSurround::processFrame(float& left, float& right) const {
+    const float a = coeffLeft * (left + right);
+    const float b = coeffRight * (right - left);
+    left = a - b;
+    right = a + b;
+}
+
+void Stereo3DSurround::applyResponse(std::complex<double>& left, std::complex<double>& right) const {
+    const std::complex<double> a = static_cast<double>(coeffLeft) * (left + right);
+    const std::complex<double> b = static_cast<double>(coeffRight) * (right - left);
+    left = a - b;
+    right = a + b;
+}
+
+DepthSurround::DepthSurround() {
+    configureFilters();
+    reset();
+}
+
 void DepthSurround::setSamplingRate(uint32_t sr) {
     samplingRate = sr;
     configureFilters();
@@ -226,16 +207,52 @@ void DepthSurround::setGainModel(float scaleDb, float offsetDb, float cap) {
     refreshStrength();
 }
 
+stereobiquad::Coefficients DepthSurround::designHighPass(float frequency, uint32_t samplingRate, double dbGain, float qFactor) {
+    if (samplingRate == 0) {
+        // Keep the filter neutral if sampling rate is unavailable.
+        return {};
+    }
+
+    const double omega = (2.0 * PI * static_cast<double>(frequency)) / static_cast<double>(samplingRate);
+    const double sinOmega = std::sin(omega);
+    const double cosOmega = std::cos(omega);
+
+    const double A = std::pow(10.0, dbGain / 40.0);
+    const double sqrtA = std::sqrt(A);
+    const double z = sinOmega / 2.0 * std::sqrt((1.0 / A + A) * (1.0 / static_cast<double>(qFactor) - 1.0) + 2.0);
+
+    const double a0 = (A + 1.0) - (A - 1.0) * cosOmega + 2.0 * sqrtA * z;
+    if (std::fabs(a0) < 1.0e-12) {
+        return {};
+    }
+    const double a1 = 2.0 * ((A - 1.0) - (A + 1.0) * cosOmega);
+    const double a2 = (A + 1.0) - (A - 1.0) * cosOmega - 2.0 * sqrtA * z;
+    // Note: b-coefficients include omega scaling to match ViPER behavior.
+    const double b0 = ((A + 1.0) + (A - 1.0) * cosOmega + 2.0 * sqrtA * z) * A * omega;
+    const double b1 = -2.0 * A * ((A - 1.0) + (A + 1.0) * cosOmega) * omega;
+    const double b2 = ((A + 1.0) + (A - 1.0) * cosOmega - 2.0 * sqrtA * z) * A * omega;
+
+    stereobiquad::Coefficients c;
+    c.b0 = b0 / a0;
+    c.b1 = b1 / a0;
+    c.b2 = b2 / a0;
+    c.a1 = a1 / a0;
+    c.a2 = a2 / a0;
+    return c;
+}
+
 void DepthSurround::reset() {
     prev[0] = 0.0f;
     prev[1] = 0.0f;
+    delay[0].clear();
+    delay[1].clear();
+    highpass.reset();
 }
 
 void DepthSurround::configureFilters() {
     delay[0].setParameters(samplingRate, delayLeftMs / 1000.0f);
     delay[1].setParameters(samplingRate, delayRightMs / 1000.0f);
-    highpass.setHighPassParameter(highpassFrequencyHz, samplingRate, highpassGainDb, highpassQ);
-    reset();
+    highpass.setCoefficients(0, designHighPass(highpassFrequencyHz, samplingRate, highpassGainDb, highpassQ), kRampFrames);
 }
 
 void DepthSurround::refreshStrength() {
@@ -256,36 +273,90 @@ void DepthSurround::refreshStrength() {
     gain = std::clamp(computedGain, 0.0f, safeGainCap);
 }
 
-void DepthSurround::process(float* samples, uint32_t frames) {
-    if (!enabled || samples == nullptr || frames == 0) {
+void DepthSurround::process(float* left, float* right, uint32_t frames) {
+    if (!enabled || left == nullptr || right == nullptr || frames == 0) {
         return;
     }
 
-    for (uint32_t i = 0; i < frames; ++i) {
-        const uint32_t index = i * 2;
-        const float sampleLeft = samples[index];
-        const float sampleRight = samples[index + 1];
-
-        prev[0] = gain * delay[0].processSample(sampleLeft + prev[1]);
-        if (strengthAtLeastThreshold) {
-            prev[1] = -gain * delay[1].processSample(sampleRight + prev[0]);
-        } else {
-            prev[1] = gain * delay[1].processSample(sampleRight + prev[0]);
+    // Within a block no delayed sample depends on the block itself, so the cross-feed only carries
+    // through prev while the delay lines are read and written as whole spans
+    const float feedbackGain = strengthAtLeastThreshold ? -gain : gain;
+    const uint32_t blockLimit = std::min({kBlockFrames, delay[0].blockLimit(), delay[1].blockLimit()});
+    float delayed[2][kBlockFrames];
+    float feed[2][kBlockFrames];
+    float diff[kBlockFrames];
+    float avg[kBlockFrames];
+    float hp[kBlockFrames];
+
+    for (uint32_t offset = 0; offset < frames; offset += blockLimit) {
+        const uint32_t count = std::min(blockLimit, frames - offset);
+        float* blockLeft = left + offset;
+        float* blockRight = right + offset;
+        delay[0].read(delayed[0], count);
+        delay[1].read(delayed[1], count);
+
+        for (uint32_t i = 0; i < count; ++i) {
+            const float sampleLeft = blockLeft[i];
+            const float sampleRight = blockRight[i];
+
+            feed[0][i] = sampleLeft + prev[1];
+            prev[0] = gain * delayed[0][i];
+            feed[1][i] = sampleRight + prev[0];
+            prev[1] = feedbackGain * delayed[1][i];
+
+            const float l = prev[0] + sampleLeft;
+            const float r = prev[1] + sampleRight;
+            diff[i] = (l - r) * 0.5f;
+            avg[i] = (l + r) * 0.5f;
         }
 
-        const float l = prev[0] + sampleLeft;
-        const float r = prev[1] + sampleRight;
+        highpass.processMono(diff, hp, count);
 
-        const float diff = (l - r) * 0.5f;
-        const float avg = (l + r) * 0.5f;
-        const float hp = highpass.processSample(diff);
-        const float side = diff - hp;
+        for (uint32_t i = 0; i < count; ++i) {
+            const float side = diff[i] - hp[i];
+            blockLeft[i] = avg[i] + side;
+            blockRight[i] = avg[i] - side;
+        }
 
-        samples[index] = avg + side;
-        samples[index + 1] = avg - side;
+        delay[0].write(feed[0], count);
+        delay[1].write(feed[1], count);
     }
 }
 
+DepthSurround::ResponseParams DepthSurround::responseParams() const {
+    ResponseParams params;
+    params.enabled = enabled;
+    params.gain = static_cast<double>(gain);
+    params.feedbackSign = strengthAtLeastThreshold ? -1.0 : 1.0;
+    params.delaySamples[0] = delay[0].delaySamples();
+    params.delaySamples[1] = delay[1].delaySamples();
+    params.highpass = highpass.coefficients(0);
+    return params;
+}
+
+void DepthSurround::ResponseParams::applyResponse(std::complex<double> zInv, std::complex<double>& left,
+                                                  std::complex<double>& right) const {
+    if (!enabled) {
+        return;
+    }
+
+    // The cross feedback closes through one sample of prev[1]:
+    // P0 = a (L + zInv P1), P1 = b (R + P0) with a = g D0 and b = +-g D1
+    const std::complex<double> a = gain * delayResponse(zInv, delaySamples[0]);
+    const std::complex<double> b = feedbackSign * gain * delayResponse(zInv, delaySamples[1]);
+    const std::complex<double> loop = a * b * zInv;
+    const std::complex<double> p0 = (a * left + loop * right) / (1.0 - loop);
+    const std::complex<double> p1 = b * (right + p0);
+
+    const std::complex<double> l = p0 + left;
+    const std::complex<double> r = p1 + right;
+    const std::complex<double> diff = (l - r) * 0.5;
+    const std::complex<double> avg = (l + r) * 0.5;
+    const std::complex<double> side = diff * (1.0 - highpass.response(zInv));
+    left = avg + side;
+    right = avg - side;
+}
+
 void FieldSurroundProcessor::setSamplingRate(uint32_t sr) {
     if (samplingRate != sr) {
         samplingRate = sr;
@@ -366,53 +437,143 @@ void FieldSurroundProcessor::setAdvancedParams(
 
 void FieldSurroundProcessor::reset() {
     depthSurround.setSamplingRate(samplingRate);
+    depthSurround.reset();
     phaseShifter[0].reset();
     phaseShifter[1].reset();
     configurePhaseShifters();
 }
 
-void FieldSurroundProcessor::process(float* samples, uint32_t frames) {
-    if (!enabled || samples == nullptr || frames == 0) {
+template <bool Depth, bool Phase, FieldSurroundProcessor::OutputMode Mode, bool MonoSum>
+void FieldSurroundProcessor::processFused(float* left, float* right, uint32_t frames) {
+    const float mixDry = 1.0f - monoSumMix;
+    const float panLeftWeight = 1.0f - std::max(0.0f, monoSumPan);
+    const float panRightWeight = 1.0f + std::min(0.0f, monoSumPan);
+
+    for (uint32_t offset = 0; offset < frames; offset += kFusedBlockFrames) {
+        const uint32_t count = std::min(kFusedBlockFrames, frames - offset);
+        float* blockLeft = left + offset;
+        float* blockRight = right + offset;
+
+        // The depth stage runs its cross-feed over the delay spans first, the rest while the block is hot
+        if constexpr (Depth) {
+            depthSurround.process(blockLeft, blockRight, count);
+        }
+
+        for (uint32_t i = 0; i < count; ++i) {
+            float l = blockLeft[i];
+            float r = blockRight[i];
+
+            stereo3dSurround.processFrame(l, r);
+
+            if constexpr (Phase) {
+                l = phaseShifter[0].processSample(l);
+                r = phaseShifter[1].processSample(r);
+            }
+
+            if constexpr (Mode != OutputMode::Normal) {
+                const float mono = Mode == OutputMode::PureSideMono
+                    ? ((r - l) * 0.5f)
+                    : ((l + r) * 0.5f);
+                l = mono;
+                r = mono;
+            }
+
+            if constexpr (MonoSum) {
+                const float mono = (l + r) * 0.5f;
+                l = (mixDry * l) + (monoSumMix * mono * panLeftWeight);
+                r = (mixDry * r) + (monoSumMix * mono * panRightWeight);
+            }
+
+            blockLeft[i] = l;
+            blockRight[i] = r;
+        }
+    }
+}
+
+// Index bit 0 depth, bit 1 phase, bit 2 mono sum, bits 3-4 output mode
+template <size_t... Index>
+constexpr std::array<FieldSurroundProcessor::Kernel, sizeof...(Index)> FieldSurroundProcessor::makeKernels(std::index_sequence<Index...>) {
+    return {{ &FieldSurroundProcessor::processFused<
+        (Index & 1) != 0,
+        (Index & 2) != 0,
+        static_cast<OutputMode>(Index >> 3),
+        (Index & 4) != 0>... }};
+}
+
+FieldSurroundProcessor::Kernel FieldSurroundProcessor::selectKernel() const {
+    static constexpr auto kernels = makeKernels(std::make_index_sequence<24>());
+    const size_t index = (depthSurround.isEnabled() ? 1 : 0)
+        | (phaseOffset != 0.0f ? 2 : 0)
+        | (monoSumMix > 0.0f ? 4 : 0)
+        | (static_cast<size_t>(outputMode) << 3);
+    return kernels[index];
+}
+
+void FieldSurroundProcessor::process(float* const* channels, uint32_t frames) {
+    if (!enabled || channels == nullptr || frames == 0) {
         return;
     }
 
-    depthSurround.process(samples, frames);
-    stereo3dSurround.process(samples, frames);
+    (this->*selectKernel())(channels[0], channels[1], frames);
+}
 
-    if (phaseOffset != 0.0f) {
-        for (uint32_t i = 0; i < frames; ++i) {
-            const uint32_t index = i * 2;
-            samples[index] = phaseShifter[0].processSample(samples[index]);
-            samples[index + 1] = phaseShifter[1].processSample(samples[index + 1]);
-        }
+FieldSurroundProcessor::ResponseParams FieldSurroundProcessor::responseParams() const {
+    ResponseParams params;
+    params.enabled = enabled;
+    params.samplingRate = samplingRate;
+    params.outputMode = outputMode;
+    params.phaseOffset = phaseOffset;
+    params.monoSumMix = monoSumMix;
+    params.monoSumPan = monoSumPan;
+    params.phaseShifter[0] = phaseShifter[0];
+    params.phaseShifter[1] = phaseShifter[1];
+    params.depthSurround = depthSurround.responseParams();
+    params.stereo3dSurround = stereo3dSurround;
+    return params;
+}
+
+void FieldSurroundProcessor::ResponseParams::frequencyResponse(double frequencyHz, std::complex<double> response[2][2]) const {
+    for (int in = 0; in < 2; ++in) {
+        response[0][in] = in == 0 ? 1.0 : 0.0;
+        response[1][in] = in == 1 ? 1.0 : 0.0;
+    }
+    if (!enabled) {
+        return;
     }
 
-    if (outputMode != OutputMode::Normal) {
-        for (uint32_t i = 0; i < frames; ++i) {
-            const uint32_t index = i * 2;
-            const float inL = samples[index];
-            const float inR = samples[index + 1];
-            const float mono = outputMode == OutputMode::PureSideMono
-                ? ((inR - inL) * 0.5f)
-                : ((inL + inR) * 0.5f);
-            samples[index] = mono;
-            samples[index + 1] = mono;
+    const double omega = (2.0 * PI * frequencyHz) / static_cast<double>(std::max<uint32_t>(1, samplingRate));
+    const std::complex<double> zInv = std::polar(1.0, -omega);
+    const float panLeftWeight = 1.0f - std::max(0.0f, monoSumPan);
+    const float panRightWeight = 1.0f + std::min(0.0f, monoSumPan);
+
+    // Every stage is linear, so the columns are the responses to a unit left and a unit right input
+    for (int in = 0; in < 2; ++in) {
+        std::complex<double> l = response[0][in];
+        std::complex<double> r = response[1][in];
+
+        depthSurround.applyResponse(zInv, l, r);
+        stereo3dSurround.applyResponse(l, r);
+
+        if (phaseOffset != 0.0f) {
+            l *= phaseShifter[0].response(zInv);
+            r *= phaseShifter[1].response(zInv);
         }
-    }
 
-    if (monoSumMix > 0.0f) {
-        const float mixDry = 1.0f - monoSumMix;
-        const float panLeftWeight = 1.0f - std::max(0.0f, monoSumPan);
-        const float panRightWeight = 1.0f + std::min(0.0f, monoSumPan);
-
-        for (uint32_t i = 0; i < frames; ++i) {
-            const uint32_t index = i * 2;
-            const float inL = samples[index];
-            const float inR = samples[index + 1];
-            const float mono = (inL + inR) * 0.5f;
-            samples[index] = (mixDry * inL) + (monoSumMix * mono * panLeftWeight);
-            samples[index + 1] = (mixDry * inR) + (monoSumMix * mono * panRightWeight);
+        if (outputMode != OutputMode::Normal) {
+            const std::complex<double> mono = outputMode == OutputMode::PureSideMono ? (r - l) * 0.5 : (l + r) * 0.5;
+            l = mono;
+            r = mono;
         }
+
+        if (monoSumMix > 0.0f) {
+            const double mixDry = 1.0 - static_cast<double>(monoSumMix);
+            const std::complex<double> mono = (l + r) * 0.5;
+            l = mixDry * l + static_cast<double>(monoSumMix * panLeftWeight) * mono;
+            r = mixDry * r + static_cast<double>(monoSumMix * panRightWeight) * mono;
+        }
+
+        response[0][in] = l;
+        response[1][in] = r;
     }
 }
 
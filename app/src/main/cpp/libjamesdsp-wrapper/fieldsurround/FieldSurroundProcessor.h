@@ -1,40 +1,48 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <complex>
+#include <cstddef>
 #include <cstdint>
+#include <utility>
 #include <vector>
 
+#include "../stereobiquad/StereoBiquad.h"
+
 namespace fieldsurround {
 
+// Longest delay and fastest rate the preallocated delay lines cover, the engine clamps delays to 100 ms
+constexpr float kMaxDelaySeconds = 0.1f;
+constexpr uint32_t kMaxSamplingRate = 192000;
+
+// Fixed delay over a power-of-two ring sized once for kMaxDelaySeconds at kMaxSamplingRate. Blocks of up
+// to blockLimit() frames are read before they are written, so both directions touch at most two
+// contiguous spans of the ring.
 class TimeConstDelay {
 public:
+    TimeConstDelay();
+    // Retargets the delay without touching the ring, the output crossfades from the old to the new tap
     void setParameters(uint32_t samplingRate, float delaySeconds);
-    float processSample(float sample);
+    void clear();
+    uint32_t delaySamples() const { return targetCount; }
+    uint32_t blockLimit() const { return std::min(sampleCount, targetCount); }
+    // Output of the next frames samples, frames <= blockLimit()
+    void read(float* output, uint32_t frames);
+    // Input for the same frames, call after read()
+    void write(const float* input, uint32_t frames);
 
 private:
-    std::vector<float> samples;
-    uint32_t sampleCount = 0;
-    uint32_t offset = 0;
-};
+    static constexpr uint32_t kFadeFrames = 256;
 
-class Biquad {
-public:
-    Biquad();
-    void reset();
-    float processSample(float sample);
-    void setHighPassParameter(float frequency, uint32_t samplingRate, double dbGain, float qFactor);
+    void readTap(float* output, uint32_t frames, uint32_t count) const;
 
-private:
-    void setCoeffs(double a0, double a1, double a2, double b0, double b1, double b2);
-
-    double x1 = 0.0;
-    double x2 = 0.0;
-    double y1 = 0.0;
-    double y2 = 0.0;
-    double a1 = 0.0;
-    double a2 = 0.0;
-    double b0 = 0.0;
-    double b1 = 0.0;
-    double b2 = 0.0;
+    std::vector<float> samples;
+    uint32_t mask = 0;
+    uint32_t sampleCount = 1;
+    uint32_t targetCount = 1;
+    uint32_t fadePosition = 0;
+    uint32_t writeIndex = 0;
 };
 
 class PhaseShifter {
@@ -42,6 +50,7 @@ public:
     void setCoefficient(float coefficient);
     float processSample(float sample);
     void reset();
+    std::complex<double> response(std::complex<double> zInv) const;
 
 private:
     float coefficient = 0.0f;
@@ -54,7 +63,9 @@ public:
     void setStereoWiden(float stereoWiden);
     void setMiddleImage(float middleImage);
     void setNormalization(float floor, float fallback);
-    void process(float* samples, uint32_t frames);
+    void process(float* left, float* right, uint32_t frames);
+    void processFrame(float& left, float& right) const;
+    void applyResponse(std::complex<double>& left, std::complex<double>& right) const;
 
 private:
     void configureVariables();
@@ -67,18 +78,41 @@ private:
     float normalizeFallback = 0.5f;
 };
 
+// Parameter changes take effect at the next process() call: delays crossfade to their new taps and the
+// high-pass ramps to its new coefficients. Only reset() clears the state.
 class DepthSurround {
 public:
+    // What the frequency response depends on, without the delay lines
+    struct ResponseParams {
+        bool enabled = false;
+        double gain = 0.0;
+        double feedbackSign = 1.0;
+        uint32_t delaySamples[2] = {1, 1};
+        stereobiquad::Coefficients highpass;
+
+        void applyResponse(std::complex<double> zInv, std::complex<double>& left, std::complex<double>& right) const;
+    };
+
+    DepthSurround();
     void setSamplingRate(uint32_t samplingRate);
     void setStrength(int16_t strength);
     void setDelayMs(float leftMs, float rightMs);
     void setHighPass(float frequencyHz, float gainDb, float qFactor);
     void setBranchThreshold(int threshold);
     void setGainModel(float scaleDb, float offsetDb, float gainCap);
-    void process(float* samples, uint32_t frames);
+    bool isEnabled() const { return enabled; }
+    void process(float* left, float* right, uint32_t frames);
     void reset();
+    ResponseParams responseParams() const;
 
 private:
+    // Frames per cross-feed block, further limited to the shorter delay
+    static constexpr uint32_t kBlockFrames = 64;
+    // Frames over which the high-pass moves to new coefficients
+    static constexpr uint32_t kRampFrames = 256;
+
+    static stereobiquad::Coefficients designHighPass(float frequency, uint32_t samplingRate, double dbGain, float qFactor);
+
     void configureFilters();
     void refreshStrength();
 
@@ -100,11 +134,35 @@ private:
     float gainCap = 1.0f;
 
     TimeConstDelay delay[2];
-    Biquad highpass;
+    // Mono side chain in the left lane, double because the cutoff reaches down to 20 Hz at up to 192 kHz
+    stereobiquad::StereoBiquad<double> highpass;
 };
 
 class FieldSurroundProcessor {
+private:
+    enum class OutputMode : int {
+        Normal = 0,
+        PureSideMono = 1,
+        MidOnlyMono = 2
+    };
+
 public:
+    // Parameters and coefficients behind frequencyResponse(), a few hundred bytes instead of the delay rings
+    struct ResponseParams {
+        bool enabled = false;
+        uint32_t samplingRate = 44100;
+        OutputMode outputMode = OutputMode::Normal;
+        float phaseOffset = 0.0f;
+        float monoSumMix = 0.0f;
+        float monoSumPan = 0.0f;
+        PhaseShifter phaseShifter[2];
+        DepthSurround::ResponseParams depthSurround;
+        Stereo3DSurround stereo3dSurround;
+
+        // Stereo transfer matrix at frequencyHz, response[out][in] with 0 = left and 1 = right
+        void frequencyResponse(double frequencyHz, std::complex<double> response[2][2]) const;
+    };
+
     void setSamplingRate(uint32_t samplingRate);
     void setEnabled(bool enabled);
     bool isEnabled() const { return enabled; }
@@ -129,14 +187,22 @@ public:
         float stereoFallback
     );
     void reset();
-    void process(float* samples, uint32_t frames);
+    // Planar stereo block in place, channels[0] left and channels[1] right
+    void process(float* const* channels, uint32_t frames);
+    ResponseParams responseParams() const;
+    void frequencyResponse(double frequencyHz, std::complex<double> response[2][2]) const {
+        responseParams().frequencyResponse(frequencyHz, response);
+    }
 
 private:
-    enum class OutputMode : int {
-        Normal = 0,
-        PureSideMono = 1,
-        MidOnlyMono = 2
-    };
+    // One pass per block of kFusedBlockFrames running only the stages enabled in the template arguments
+    template <bool Depth, bool Phase, OutputMode Mode, bool MonoSum>
+    void processFused(float* left, float* right, uint32_t frames);
+    static constexpr uint32_t kFusedBlockFrames = 256;
+    using Kernel = void (FieldSurroundProcessor::*)(float*, float*, uint32_t);
+    template <size_t... Index>
+    static constexpr std::array<Kernel, sizeof...(Index)> makeKernels(std::index_sequence<Index...>);
+    Kernel selectKernel() const;
 
     void configurePhaseShifters();
 
@@ -0,0 +1,171 @@
+#include "EdgeResampler.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace fixedrate {
+
+// Input frames the sinc converter holds back before it produces output, mirrors half_filter_chan_len in src_sinc.c
+static uint32_t converterLookahead(double ratio) {
+    static constexpr double kHalfTaps = (22438.0 - 2.0 + 2.0) / 491.0;
+    const double count = ratio < 1.0 ? kHalfTaps / ratio : kHalfTaps;
+    return static_cast<uint32_t>(std::lrint(count)) + 1;
+}
+
+EdgeResampler::~EdgeResampler() {
+    freeConverters();
+}
+
+void EdgeResampler::freeConverters() {
+    if (inputSrc != nullptr) {
+        src_delete(inputSrc);
+        inputSrc = nullptr;
+    }
+    if (outputSrc != nullptr) {
+        src_delete(outputSrc);
+        outputSrc = nullptr;
+    }
+}
+
+bool EdgeResampler::configure(uint32_t newInternalRate, uint32_t newDeviceRate) {
+    internalRate = newInternalRate;
+    if (internalRate == 0) {
+        freeConverters();
+        internal.clear();
+        internal.shrink_to_fit();
+        output.clear();
+        output.shrink_to_fit();
+        outputFill = 0;
+        if (newDeviceRate > 0) {
+            deviceRate = newDeviceRate;
+        }
+        return true;
+    }
+
+    if (inputSrc == nullptr || outputSrc == nullptr) {
+        int error = 0;
+        freeConverters();
+        inputSrc = src_new(SRC_SINC_MEDIUM_QUALITY, kChannels, &error);
+        outputSrc = src_new(SRC_SINC_MEDIUM_QUALITY, kChannels, &error);
+        if (inputSrc == nullptr || outputSrc == nullptr) {
+            freeConverters();
+            internalRate = 0;
+            return false;
+        }
+    }
+    setDeviceRate(newDeviceRate > 0 ? newDeviceRate : deviceRate);
+    return true;
+}
+
+void EdgeResampler::setDeviceRate(uint32_t newDeviceRate) {
+    if (newDeviceRate > 0) {
+        deviceRate = newDeviceRate;
+    }
+    if (internalRate == 0) {
+        return;
+    }
+    inputRatio = static_cast<double>(internalRate) / static_cast<double>(deviceRate);
+    outputRatio = static_cast<double>(deviceRate) / static_cast<double>(internalRate);
+
+    // Enough silence up front that the output queue never runs dry while both converters fill up.
+    // One extra frame per stage covers the rounding of the produced frame counts.
+    const double outputLookahead = converterLookahead(outputRatio) * outputRatio;
+    primeFrames = converterLookahead(inputRatio) + static_cast<uint32_t>(std::ceil(outputLookahead)) + 2;
+    reset();
+}
+
+void EdgeResampler::reset() {
+    if (inputSrc != nullptr) {
+        src_reset(inputSrc);
+    }
+    if (outputSrc != nullptr) {
+        src_reset(outputSrc);
+    }
+    underruns = 0;
+    if (!isResampling()) {
+        outputFill = 0;
+        return;
+    }
+    if (output.size() < static_cast<size_t>(primeFrames) * kChannels) {
+        output.resize(static_cast<size_t>(primeFrames) * kChannels);
+    }
+    std::fill(output.begin(), output.begin() + static_cast<size_t>(primeFrames) * kChannels, 0.0f);
+    outputFill = primeFrames;
+}
+
+uint32_t EdgeResampler::convertInput(const float* samples, uint32_t frames) {
+    const size_t capacity = static_cast<size_t>(std::ceil(frames * inputRatio)) + 16;
+    if (internal.size() < capacity * kChannels) {
+        internal.resize(capacity * kChannels);
+    }
+
+    SRC_DATA data;
+    std::memset(&data, 0, sizeof(data));
+    data.data_in = samples;
+    data.input_frames = frames;
+    data.src_ratio = inputRatio;
+    long generated = 0;
+    while (data.input_frames > 0) {
+        data.data_out = internal.data() + generated * kChannels;
+        data.output_frames = static_cast<long>(capacity) - generated;
+        if (src_process(inputSrc, &data) != 0) {
+            break;
+        }
+        generated += data.output_frames_gen;
+        data.data_in += data.input_frames_used * kChannels;
+        data.input_frames -= data.input_frames_used;
+        if (data.input_frames_used == 0 && data.output_frames_gen == 0) {
+            break;
+        }
+    }
+    return static_cast<uint32_t>(generated);
+}
+
+void EdgeResampler::convertOutput(uint32_t internalFrames) {
+    if (internalFrames == 0) {
+        return;
+    }
+    const size_t capacity = static_cast<size_t>(std::ceil(internalFrames * outputRatio)) + 16;
+    const size_t required = (outputFill + capacity) * kChannels;
+    if (output.size() < required) {
+        output.resize(required);
+    }
+
+    SRC_DATA data;
+    std::memset(&data, 0, sizeof(data));
+    data.data_in = internal.data();
+    data.input_frames = internalFrames;
+    data.src_ratio = outputRatio;
+    while (data.input_frames > 0) {
+        data.data_out = output.data() + static_cast<size_t>(outputFill) * kChannels;
+        data.output_frames = static_cast<long>(output.size() / kChannels) - outputFill;
+        if (src_process(outputSrc, &data) != 0) {
+            break;
+        }
+        outputFill += static_cast<uint32_t>(data.output_frames_gen);
+        data.data_in += data.input_frames_used * kChannels;
+        data.input_frames -= data.input_frames_used;
+        if (data.input_frames_used == 0 && data.output_frames_gen == 0) {
+            break;
+        }
+    }
+}
+
+void EdgeResampler::readOutput(float* samples, uint32_t frames) {
+    const uint32_t available = std::min(frames, outputFill);
+    std::memcpy(samples, output.data(), static_cast<size_t>(available) * kChannels * sizeof(float));
+    if (available < frames) {
+        // Only possible if the priming was too short; pad with silence, the queue catches up by itself
+        std::memset(samples + static_cast<size_t>(available) * kChannels, 0,
+                    static_cast<size_t>(frames - available) * kChannels * sizeof(float));
+        ++underruns;
+    }
+    outputFill -= available;
+    if (outputFill > 0) {
+        std::memmove(output.data(), output.data() + static_cast<size_t>(available) * kChannels,
+                     static_cast<size_t>(outputFill) * kChannels * sizeof(float));
+    }
+}
+
+} // namespace fixedrate
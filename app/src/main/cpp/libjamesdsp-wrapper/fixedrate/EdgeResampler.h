@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+extern "C" {
+#include "../../libjdspimptoolbox/libsamplerate/samplerate.h"
+}
+
+namespace fixedrate {
+
+// Keeps the effect chain at one internal sampling rate and converts stereo audio from the device rate
+// on the way in and back on the way out. A device rate change only retunes the two converters, the
+// chain and all of its filter state stay untouched.
+class EdgeResampler {
+public:
+    ~EdgeResampler();
+
+    // internalRate == 0 turns fixed-rate processing off. Returns false if the converters cannot be created.
+    bool configure(uint32_t internalRate, uint32_t deviceRate);
+    void setDeviceRate(uint32_t deviceRate);
+    void reset();
+
+    bool isEnabled() const { return internalRate != 0; }
+    bool isResampling() const { return isEnabled() && inputSrc != nullptr && internalRate != deviceRate; }
+    uint32_t getInternalRate() const { return internalRate; }
+    uint32_t getDeviceRate() const { return deviceRate; }
+    // Delay added by the two converters, in device frames
+    uint32_t getLatencyFrames() const { return isResampling() ? primeFrames : 0; }
+    uint32_t getUnderrunCount() const { return underruns; }
+
+    // Converts frames interleaved stereo device frames in place, chain(samples, frames) runs at the internal rate
+    template <typename Chain>
+    void process(float* samples, uint32_t frames, Chain&& chain) {
+        if (!isResampling()) {
+            chain(samples, frames);
+            return;
+        }
+        const uint32_t internalFrames = convertInput(samples, frames);
+        if (internalFrames > 0) {
+            chain(internal.data(), internalFrames);
+        }
+        convertOutput(internalFrames);
+        readOutput(samples, frames);
+    }
+
+private:
+    static constexpr int kChannels = 2;
+
+    void freeConverters();
+    uint32_t convertInput(const float* samples, uint32_t frames);
+    void convertOutput(uint32_t internalFrames);
+    void readOutput(float* samples, uint32_t frames);
+
+    uint32_t internalRate = 0;
+    uint32_t deviceRate = 48000;
+    double inputRatio = 1.0;
+    double outputRatio = 1.0;
+    uint32_t primeFrames = 0;
+    uint32_t underruns = 0;
+
+    SRC_STATE* inputSrc = nullptr;
+    SRC_STATE* outputSrc = nullptr;
+
+    std::vector<float> internal;
+    // Device rate output waiting to be handed out, outputFill frames are valid
+    std::vector<float> output;
+    uint32_t outputFill = 0;
+};
+
+} // namespace fixedrate
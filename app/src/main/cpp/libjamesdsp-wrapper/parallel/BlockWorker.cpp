@@ -0,0 +1,66 @@
+#include "BlockWorker.h"
+
+namespace parallel {
+
+static inline void cpuRelax() {
+#if defined(__aarch64__) || defined(__arm__)
+    asm volatile("yield");
+#elif defined(__i386__) || defined(__x86_64__)
+    __builtin_ia32_pause();
+#endif
+}
+
+BlockWorker::BlockWorker(Task task, void* context, Setup setup)
+    : task(task), context(context), setup(setup), thread(&BlockWorker::loop, this) {
+}
+
+BlockWorker::~BlockWorker() {
+    {
+        std::lock_guard<std::mutex> lock(parkMutex);
+        stopping.store(true);
+    }
+    parkCondition.notify_all();
+    thread.join();
+}
+
+void BlockWorker::submit(uint64_t count) {
+    // Both sides store before they load, so either the worker sees the new count before it parks or this
+    // sees it parked
+    submitted.store(count);
+    if (parked.load()) {
+        std::lock_guard<std::mutex> lock(parkMutex);
+        parkCondition.notify_one();
+    }
+}
+
+void BlockWorker::waitFor(uint64_t count) const {
+    for (int spins = 0; done.load(std::memory_order_acquire) < count; ++spins) {
+        if (spins < kSpinIterations) {
+            cpuRelax();
+        } else {
+            std::this_thread::yield();
+        }
+    }
+}
+
+void BlockWorker::loop() {
+    if (setup != nullptr) {
+        setup(context);
+    }
+    uint64_t next = 0;
+    for (;;) {
+        if (submitted.load() <= next && !stopping.load(std::memory_order_relaxed)) {
+            std::unique_lock<std::mutex> lock(parkMutex);
+            parked.store(true);
+            parkCondition.wait(lock, [this, next] { return submitted.load() > next || stopping.load(); });
+            parked.store(false);
+        }
+        if (stopping.load()) {
+            return;
+        }
+        task(context, next);
+        done.store(++next, std::memory_order_release);
+    }
+}
+
+} // namespace parallel
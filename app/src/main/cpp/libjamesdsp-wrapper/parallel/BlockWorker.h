@@ -0,0 +1,53 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace parallel {
+
+// A thread that runs task(context, block) for blocks 0, 1, 2, ... in order as the owner submits them, the
+// hand-off behind the pipelined chain and the partitioned convolver's tail segments. Blocks arrive one block
+// period apart at the most, which dwarfs the wake-up latency, so an idle worker parks right away instead of
+// spinning on a core the audio thread may need. Only the owner spins, and only while it waits for a block
+// that is already late.
+class BlockWorker {
+public:
+    using Task = void (*)(void* context, uint64_t block);
+    // Runs once on the worker thread before the first block, for affinity or priority
+    using Setup = void (*)(void* context);
+
+    // Starts the thread, context has to be ready for setup and task by now
+    BlockWorker(Task task, void* context, Setup setup = nullptr);
+    ~BlockWorker();
+    BlockWorker(const BlockWorker&) = delete;
+    BlockWorker& operator=(const BlockWorker&) = delete;
+
+    // Makes every block below count available to the worker, count only grows
+    void submit(uint64_t count);
+    // Blocks the worker finished, everything they wrote is visible to the caller
+    uint64_t completed() const { return done.load(std::memory_order_acquire); }
+    // Returns once the worker finished every block below count
+    void waitFor(uint64_t count) const;
+
+private:
+    static constexpr int kSpinIterations = 20000;
+
+    void loop();
+
+    const Task task;
+    void* const context;
+    const Setup setup;
+
+    std::atomic<uint64_t> submitted{0};
+    std::atomic<uint64_t> done{0};
+    std::atomic<bool> parked{false};
+    std::atomic<bool> stopping{false};
+    std::mutex parkMutex;
+    std::condition_variable parkCondition;
+    std::thread thread;
+};
+
+} // namespace parallel
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+namespace pipeline {
+
+// Base of every stage. A stage processes a planar stereo block in place through
+// run(float* const* channels, uint32_t frames) const and only refers to the processor it drives, so
+// stages are cheap to build per block.
+struct Stage {};
+
+template <typename... Stages>
+class Chain : public Stage {
+public:
+    explicit Chain(const std::tuple<Stages...>& stages) : stages(stages) {}
+
+    // Every stage over the whole block in composition order, the calls are resolved at compile time
+    void run(float* const* channels, uint32_t frames) const {
+        std::apply([channels, frames](const Stages&... stage) { (stage.run(channels, frames), ...); }, stages);
+    }
+
+    const std::tuple<Stages...>& parts() const { return stages; }
+
+private:
+    std::tuple<Stages...> stages;
+};
+
+template <typename T>
+struct IsChain : std::false_type {};
+template <typename... Stages>
+struct IsChain<Chain<Stages...>> : std::true_type {};
+
+template <typename T>
+auto flatten(const T& stage) {
+    if constexpr (IsChain<T>::value) {
+        return stage.parts();
+    } else {
+        return std::make_tuple(stage);
+    }
+}
+
+template <typename Tuple>
+struct ChainOf;
+template <typename... Stages>
+struct ChainOf<std::tuple<Stages...>> { using type = Chain<Stages...>; };
+
+// a >> b runs a, then b. Nested compositions flatten into one Chain
+template <typename A, typename B,
+          typename = std::enable_if_t<std::is_base_of_v<Stage, A> && std::is_base_of_v<Stage, B>>>
+auto operator>>(const A& a, const B& b) {
+    auto stages = std::tuple_cat(flatten(a), flatten(b));
+    return typename ChainOf<decltype(stages)>::type(stages);
+}
+
+// Table of block kernels, one instantiation of Variant<Mask> per active-stage mask below Count. The caller
+// picks an entry once per block, so the chosen kernel runs without per-stage enable checks.
+template <typename Kernel, template <uint32_t> class Variant, size_t Count>
+class KernelTable {
+public:
+    static Kernel select(uint32_t mask) { return kernels[mask]; }
+
+private:
+    template <size_t... Mask>
+    static constexpr std::array<Kernel, sizeof...(Mask)> make(std::index_sequence<Mask...>) {
+        return {{ &Variant<static_cast<uint32_t>(Mask)>::run... }};
+    }
+
+    static constexpr std::array<Kernel, Count> kernels = make(std::make_index_sequence<Count>());
+};
+
+} // namespace pipeline
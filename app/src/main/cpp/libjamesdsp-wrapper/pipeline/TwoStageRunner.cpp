@@ -0,0 +1,70 @@
+#include "TwoStageRunner.h"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+namespace pipeline {
+
+TwoStageRunner::TwoStageRunner(Segment back, void* context)
+    : back(back), context(context), worker(&TwoStageRunner::runBack, this, &TwoStageRunner::pinWorker) {
+}
+
+float* const* TwoStageRunner::beginBlock(uint32_t frames) {
+    if (frames != blockFrames) {
+        flush();
+        blockFrames = frames;
+    }
+    return slots[sequence & 1].reserve(frames);
+}
+
+float* const* TwoStageRunner::endBlock() {
+    const uint32_t frames = blockFrames;
+    slotFrames[sequence & 1] = frames;
+    worker.submit(sequence + 1);
+
+    if (!hasPrevious) {
+        hasPrevious = true;
+        ++sequence;
+        float* const* channels = silence.reserve(frames);
+        std::fill(channels[0], channels[0] + frames, 0.0f);
+        std::fill(channels[1], channels[1] + frames, 0.0f);
+        return channels;
+    }
+
+    // Block sequence - 1 went out one call ago, normally it finished long before
+    worker.waitFor(sequence);
+    float* const* channels = slots[(sequence - 1) & 1].reserve(frames);
+    ++sequence;
+    return channels;
+}
+
+void TwoStageRunner::flush() {
+    worker.waitFor(sequence);
+    hasPrevious = false;
+}
+
+void TwoStageRunner::pinWorker(void* self) {
+    (void)self;
+#ifdef __linux__
+    // Pinned to the highest numbered core, the fast cluster on current big.LITTLE designs. The scheduler may refuse.
+    const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cores > 1) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(static_cast<int>(cores - 1), &set);
+        sched_setaffinity(0, sizeof(set), &set);
+    }
+#endif
+}
+
+void TwoStageRunner::runBack(void* self, uint64_t block) {
+    auto* runner = static_cast<TwoStageRunner*>(self);
+    const uint32_t frames = runner->slotFrames[block & 1];
+    runner->back(runner->context, runner->slots[block & 1].reserve(frames), frames);
+}
+
+} // namespace pipeline
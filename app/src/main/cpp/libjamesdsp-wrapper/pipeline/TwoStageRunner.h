@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+
+#include "../parallel/BlockWorker.h"
+#include "../planar/PlanarBuffer.h"
+
+namespace pipeline {
+
+// Runs a block chain split into two segments on two threads connected by a two-slot block queue. The caller
+// fills block k and runs the front segment on it, hands it to the back segment's thread and takes back block
+// k - 1 with both segments applied. Each segment thereby gets a whole block period of its own, in exchange
+// for exactly one block of output latency.
+class TwoStageRunner {
+public:
+    using Segment = void (*)(void* context, float* const* channels, uint32_t frames);
+
+    TwoStageRunner(Segment back, void* context);
+    TwoStageRunner(const TwoStageRunner&) = delete;
+    TwoStageRunner& operator=(const TwoStageRunner&) = delete;
+
+    // Slot for the next block of frames frames, the caller fills it and runs the front segment in place.
+    // A block size different from the previous one flushes the pipeline first.
+    float* const* beginBlock(uint32_t frames);
+    // Queues the filled slot for the back segment and returns the previous block, which stays valid until
+    // the next beginBlock(). The first block after a flush returns silence.
+    float* const* endBlock();
+    // Waits for the back segment to go idle and drops the block in flight
+    void flush();
+
+private:
+    static void pinWorker(void* self);
+    static void runBack(void* self, uint64_t block);
+
+    const Segment back;
+    void* const context;
+
+    planar::PlanarBuffer slots[2];
+    planar::PlanarBuffer silence;
+    uint32_t slotFrames[2] = {0, 0};
+    uint32_t blockFrames = 0;
+    bool hasPrevious = false;
+    uint64_t sequence = 0;
+
+    // Runs the back segment, last so it starts once everything above is in place
+    parallel::BlockWorker worker;
+};
+
+} // namespace pipeline
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace planar {
+
+// Stereo scratch block with the left and right channel in separate arrays, each starting on a cache line.
+// Grows to the largest block seen and is reused afterwards, so steady-state processing does not allocate.
+class PlanarBuffer {
+public:
+    // Channel pointers for at least frames frames, valid until the next call
+    float* const* reserve(uint32_t frames) {
+        const size_t stride = (static_cast<size_t>(frames) + kAlignFloats - 1) / kAlignFloats * kAlignFloats;
+        if (stride > capacity) {
+            storage.resize(stride * 2 + kAlignFloats - 1);
+            const auto base = reinterpret_cast<uintptr_t>(storage.data());
+            const uintptr_t aligned = (base + kAlignBytes - 1) & ~static_cast<uintptr_t>(kAlignBytes - 1);
+            channels[0] = reinterpret_cast<float*>(aligned);
+            channels[1] = channels[0] + stride;
+            capacity = stride;
+        }
+        return channels;
+    }
+
+private:
+    static constexpr size_t kAlignBytes = 64;
+    static constexpr size_t kAlignFloats = kAlignBytes / sizeof(float);
+
+    std::vector<float> storage;
+    float* channels[2] = {nullptr, nullptr};
+    size_t capacity = 0;
+};
+
+} // namespace planar
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <algorithm>
+#include <complex>
+#include <cstddef>
+#include <cstdint>
+
+namespace stereobiquad {
+
+// Normalized second-order section, H(z) = (b0 + b1 z^-1 + b2 z^-2) / (1 + a1 z^-1 + a2 z^-2)
+struct Coefficients {
+    double b0 = 1.0;
+    double b1 = 0.0;
+    double b2 = 0.0;
+    double a1 = 0.0;
+    double a2 = 0.0;
+
+    bool operator==(const Coefficients& o) const {
+        return b0 == o.b0 && b1 == o.b1 && b2 == o.b2 && a1 == o.a1 && a2 == o.a2;
+    }
+    bool operator!=(const Coefficients& o) const { return !(*this == o); }
+
+    // Transfer function at zInv = e^-jw
+    std::complex<double> response(std::complex<double> zInv) const {
+        const std::complex<double> zInv2 = zInv * zInv;
+        return (b0 + b1 * zInv + b2 * zInv2) / (1.0 + a1 * zInv + a2 * zInv2);
+    }
+};
+
+template <typename Real>
+struct Lanes;
+// float32x2 on arm, split into scalar or SSE ops by the compiler elsewhere
+template <>
+struct Lanes<float> { typedef float Vec __attribute__((vector_size(8))); };
+// float64x2 on arm64, SSE2 on x86
+template <>
+struct Lanes<double> { typedef double Vec __attribute__((vector_size(16))); };
+
+// Cascade of transposed direct form II sections with the left and right channel in the two lanes of one
+// SIMD register. float suits most sections, double is meant for sections whose poles sit close to z = 1
+// (cutoff low relative to the sampling rate). Blocks run through a branch free loop unless a coefficient
+// ramp is pending.
+template <typename Real, size_t Sections = 1>
+class StereoBiquad {
+public:
+    using Vec = typename Lanes<Real>::Vec;
+
+    StereoBiquad() {
+        for (size_t s = 0; s < Sections; ++s) {
+            load(s, target[s]);
+        }
+        reset();
+    }
+
+    // rampFrames == 0 jumps to c, otherwise the section moves there linearly over rampFrames frames
+    // with its state kept. A ramp restarts every section that has not reached its target yet.
+    void setCoefficients(size_t s, const Coefficients& c, uint32_t rampFrames = 0) {
+        if (c == target[s] && rampRemaining == 0) {
+            return;
+        }
+        target[s] = c;
+        if (rampFrames == 0) {
+            load(s, c);
+            return;
+        }
+        rampRemaining = rampFrames;
+        const Real inverse = static_cast<Real>(1.0 / static_cast<double>(rampFrames));
+        for (size_t i = 0; i < Sections; ++i) {
+            Section& x = section[i];
+            x.db0 = (splat(target[i].b0) - x.b0) * inverse;
+            x.db1 = (splat(target[i].b1) - x.b1) * inverse;
+            x.db2 = (splat(target[i].b2) - x.b2) * inverse;
+            x.da1 = (splat(target[i].a1) - x.a1) * inverse;
+            x.da2 = (splat(target[i].a2) - x.a2) * inverse;
+        }
+    }
+
+    const Coefficients& coefficients(size_t s) const { return target[s]; }
+
+    // Clears the state and finishes a pending ramp
+    void reset() {
+        for (size_t s = 0; s < Sections; ++s) {
+            load(s, target[s]);
+            section[s].s1 = splat(0.0);
+            section[s].s2 = splat(0.0);
+        }
+        rampRemaining = 0;
+    }
+
+    // Interleaved stereo block in place
+    void process(float* samples, uint32_t frames) {
+        run(frames,
+            [samples](uint32_t i) { return Vec{static_cast<Real>(samples[i * 2]), static_cast<Real>(samples[i * 2 + 1])}; },
+            [samples](uint32_t i, Vec y) {
+                samples[i * 2] = static_cast<float>(y[0]);
+                samples[i * 2 + 1] = static_cast<float>(y[1]);
+            });
+    }
+
+    // Planar stereo block in place
+    void processPlanar(float* left, float* right, uint32_t frames) {
+        run(frames,
+            [left, right](uint32_t i) { return Vec{static_cast<Real>(left[i]), static_cast<Real>(right[i])}; },
+            [left, right](uint32_t i, Vec y) {
+                left[i] = static_cast<float>(y[0]);
+                right[i] = static_cast<float>(y[1]);
+            });
+    }
+
+    // Mono block through the left lane, input and output may alias
+    void processMono(const float* input, float* output, uint32_t frames) {
+        run(frames,
+            [input](uint32_t i) { return Vec{static_cast<Real>(input[i]), static_cast<Real>(0)}; },
+            [output](uint32_t i, Vec y) { output[i] = static_cast<float>(y[0]); });
+    }
+
+    // Transfer function of the target coefficients at zInv = e^-jw
+    std::complex<double> response(std::complex<double> zInv) const {
+        std::complex<double> h = 1.0;
+        for (size_t s = 0; s < Sections; ++s) {
+            h *= target[s].response(zInv);
+        }
+        return h;
+    }
+
+private:
+    struct Section {
+        Vec b0, b1, b2, a1, a2;
+        Vec s1, s2;
+        Vec db0, db1, db2, da1, da2;
+    };
+
+    static Vec splat(double v) {
+        const auto r = static_cast<Real>(v);
+        return Vec{r, r};
+    }
+
+    void load(size_t s, const Coefficients& c) {
+        Section& x = section[s];
+        x.b0 = splat(c.b0);
+        x.b1 = splat(c.b1);
+        x.b2 = splat(c.b2);
+        x.a1 = splat(c.a1);
+        x.a2 = splat(c.a2);
+    }
+
+    static Vec tick(Section* sections, Vec x) {
+        for (size_t s = 0; s < Sections; ++s) {
+            Section& f = sections[s];
+            // Feed-forward terms first so only one multiply and one add sit on the recursive path
+            const Vec y = f.b0 * x + f.s1;
+            f.s1 = (f.b1 * x + f.s2) - f.a1 * y;
+            f.s2 = f.b2 * x - f.a2 * y;
+            x = y;
+        }
+        return x;
+    }
+
+    void stepRamp() {
+        for (size_t s = 0; s < Sections; ++s) {
+            Section& f = section[s];
+            f.b0 += f.db0;
+            f.b1 += f.db1;
+            f.b2 += f.db2;
+            f.a1 += f.da1;
+            f.a2 += f.da2;
+        }
+        if (--rampRemaining == 0) {
+            // Land exactly on the target regardless of accumulated rounding
+            for (size_t s = 0; s < Sections; ++s) {
+                load(s, target[s]);
+            }
+        }
+    }
+
+    template <typename Load, typename Store>
+    void run(uint32_t frames, Load&& loadFrame, Store&& storeFrame) {
+        uint32_t i = 0;
+        for (; i < frames && rampRemaining > 0; ++i) {
+            stepRamp();
+            storeFrame(i, tick(section, loadFrame(i)));
+        }
+        if (i == frames) {
+            return;
+        }
+        // Float stores to the block may alias the float lanes of the members, a local copy keeps the
+        // cascade in registers
+        Section local[Sections];
+        std::copy(section, section + Sections, local);
+        for (; i < frames; ++i) {
+            storeFrame(i, tick(local, loadFrame(i)));
+        }
+        for (size_t s = 0; s < Sections; ++s) {
+            section[s].s1 = local[s].s1;
+            section[s].s2 = local[s].s2;
+        }
+    }
+
+    Section section[Sections];
+    Coefficients target[Sections];
+    uint32_t rampRemaining = 0;
+};
+
+} // namespace stereobiquad
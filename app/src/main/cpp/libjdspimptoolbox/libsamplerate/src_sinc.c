@@ -13,6 +13,7 @@
 #include "config.h"
 #include "float_cast.h"
 #include "common.h"
+#include "src_sinc_simd.h"
 
 #define	SINC_MAGIC_MARKER	MAKE_MAGIC (' ', 's', 'i', 'n', 'c', ' ')
 
@@ -43,6 +44,9 @@ typedef struct
 
 	float const	*coeffs ;
 
+	/* Dot product kernels for the mono, stereo and quad converters. */
+	const SINC_DOT_FUNCS	*dot ;
+
 	int		b_current, b_end, b_real_end, b_len ;
 
 	/* Sure hope noone does more than 128 channels at once. */
@@ -87,7 +91,9 @@ fp_to_double (increment_t x)
 {	return fp_fraction_part (x) * INV_FP_ONE ;
 } /* fp_to_double */
 
-extern float *decompressedCoefficients;
+/* Provided by the toolbox, decompresses the shared table on first use. */
+extern const float *resamplerCoefficients (void) ;
+
 int
 sinc_set_converter (SRC_PRIVATE *psrc, int src_enum)
 {	SINC_FILTER *filter, temp_filter ;
@@ -108,9 +114,12 @@ sinc_set_converter (SRC_PRIVATE *psrc, int src_enum)
 	temp_filter.sinc_magic_marker = SINC_MAGIC_MARKER ;
 	temp_filter.channels = psrc->channels ;
 
-    temp_filter.coeffs = decompressedCoefficients;
+    temp_filter.coeffs = resamplerCoefficients ();
+	if (temp_filter.coeffs == NULL)
+		return SRC_ERR_MALLOC_FAILED ;
     temp_filter.coeff_half_len = 22438 - 2;
     temp_filter.index_inc = 491;
+	temp_filter.dot = sinc_dot_funcs () ;
 
 	if (psrc->channels > ARRAY_LEN (temp_filter.left_calc))
 		return SRC_ERR_BAD_CHANNEL_COUNT ;
@@ -191,54 +200,73 @@ sinc_reset (SRC_PRIVATE *psrc)
 **	Beware all ye who dare pass this point. There be dragons here.
 */
 
-static inline double
-calc_output_single (SINC_FILTER *filter, increment_t increment, increment_t start_filter_index)
-{	double		fraction, left, right, icoeff ;
-	increment_t	filter_index, max_filter_index ;
-	int			data_index, coeff_count, indx ;
+#define	SINC_DOT_BLOCK			64
 
-	/* Convert input parameters into fixed point. */
-	max_filter_index = int_to_fp (filter->coeff_half_len) ;
+/*
+** Interpolate taps filter coefficients starting at filter_index and stepping
+** by step, handing them to the dot product kernel in blocks that stay in L1.
+*/
+static inline void
+apply_filter_half (const SINC_FILTER *filter, sinc_dot_func dot, increment_t filter_index, increment_t step,
+			const float *data, int taps, double *acc)
+{	double	icoeff [SINC_DOT_BLOCK], fraction ;
+	int		k, n, indx ;
 
-	/* First apply the left half of the filter. */
-	filter_index = start_filter_index ;
-	coeff_count = (max_filter_index - filter_index) / increment ;
-	filter_index = filter_index + coeff_count * increment ;
-	data_index = filter->b_current - coeff_count ;
+	while (taps > 0)
+	{	n = MIN (taps, SINC_DOT_BLOCK) ;
 
-	left = 0.0 ;
-	do
-	{	fraction = fp_to_double (filter_index) ;
-		indx = fp_to_int (filter_index) ;
+		for (k = 0 ; k < n ; k++)
+		{	fraction = fp_to_double (filter_index) ;
+			indx = fp_to_int (filter_index) ;
 
-		icoeff = filter->coeffs [indx] + fraction * (filter->coeffs [indx + 1] - filter->coeffs [indx]) ;
+			icoeff [k] = filter->coeffs [indx] + fraction * (filter->coeffs [indx + 1] - filter->coeffs [indx]) ;
 
-		left += icoeff * filter->buffer [data_index] ;
+			filter_index += step ;
+			} ;
 
-		filter_index -= increment ;
-		data_index = data_index + 1 ;
-		}
-	while (filter_index >= MAKE_INCREMENT_T (0)) ;
+		dot (icoeff, data, n, acc) ;
+
+		data += n * filter->channels ;
+		taps -= n ;
+		} ;
+} /* apply_filter_half */
+
+/*
+** Both halves are evaluated with the input running forwards through memory,
+** the right half therefore walks the filter from its tail towards the centre.
+*/
+static inline void
+calc_output_halves (SINC_FILTER *filter, sinc_dot_func dot, increment_t increment, increment_t start_filter_index,
+			double *left, double *right)
+{	increment_t	filter_index, max_filter_index ;
+	int			coeff_count, taps ;
+
+	/* Convert input parameters into fixed point. */
+	max_filter_index = int_to_fp (filter->coeff_half_len) ;
+
+	/* First apply the left half of the filter. */
+	coeff_count = (max_filter_index - start_filter_index) / increment ;
+	filter_index = start_filter_index + coeff_count * increment ;
+	taps = filter_index / increment + 1 ;
+
+	apply_filter_half (filter, dot, filter_index, -increment,
+				filter->buffer + filter->b_current - filter->channels * coeff_count, taps, left) ;
 
 	/* Now apply the right half of the filter. */
 	filter_index = increment - start_filter_index ;
 	coeff_count = (max_filter_index - filter_index) / increment ;
 	filter_index = filter_index + coeff_count * increment ;
-	data_index = filter->b_current + 1 + coeff_count ;
+	taps = filter_index > MAKE_INCREMENT_T (0) ? (filter_index - 1) / increment + 1 : 1 ;
 
-	right = 0.0 ;
-	do
-	{	fraction = fp_to_double (filter_index) ;
-		indx = fp_to_int (filter_index) ;
+	apply_filter_half (filter, dot, filter_index - (taps - 1) * increment, increment,
+				filter->buffer + filter->b_current + filter->channels * (2 + coeff_count - taps), taps, right) ;
+} /* calc_output_halves */
 
-		icoeff = filter->coeffs [indx] + fraction * (filter->coeffs [indx + 1] - filter->coeffs [indx]) ;
+static inline double
+calc_output_single (SINC_FILTER *filter, increment_t increment, increment_t start_filter_index)
+{	double		left = 0.0, right = 0.0 ;
 
-		right += icoeff * filter->buffer [data_index] ;
-
-		filter_index -= increment ;
-		data_index = data_index - 1 ;
-		}
-	while (filter_index > MAKE_INCREMENT_T (0)) ;
+	calc_output_halves (filter, filter->dot->mono, increment, start_filter_index, &left, &right) ;
 
 	return (left + right) ;
 } /* calc_output_single */
@@ -338,54 +366,9 @@ sinc_mono_vari_process (SRC_PRIVATE *psrc, SRC_DATA *data)
 
 static inline void
 calc_output_stereo (SINC_FILTER *filter, increment_t increment, increment_t start_filter_index, double scale, float * output)
-{	double		fraction, left [2], right [2], icoeff ;
-	increment_t	filter_index, max_filter_index ;
-	int			data_index, coeff_count, indx ;
-
-	/* Convert input parameters into fixed point. */
-	max_filter_index = int_to_fp (filter->coeff_half_len) ;
-
-	/* First apply the left half of the filter. */
-	filter_index = start_filter_index ;
-	coeff_count = (max_filter_index - filter_index) / increment ;
-	filter_index = filter_index + coeff_count * increment ;
-	data_index = filter->b_current - filter->channels * coeff_count ;
-
-	left [0] = left [1] = 0.0 ;
-	do
-	{	fraction = fp_to_double (filter_index) ;
-		indx = fp_to_int (filter_index) ;
-
-		icoeff = filter->coeffs [indx] + fraction * (filter->coeffs [indx + 1] - filter->coeffs [indx]) ;
-
-		left [0] += icoeff * filter->buffer [data_index] ;
-		left [1] += icoeff * filter->buffer [data_index + 1] ;
-
-		filter_index -= increment ;
-		data_index = data_index + 2 ;
-		}
-	while (filter_index >= MAKE_INCREMENT_T (0)) ;
-
-	/* Now apply the right half of the filter. */
-	filter_index = increment - start_filter_index ;
-	coeff_count = (max_filter_index - filter_index) / increment ;
-	filter_index = filter_index + coeff_count * increment ;
-	data_index = filter->b_current + filter->channels * (1 + coeff_count) ;
-
-	right [0] = right [1] = 0.0 ;
-	do
-	{	fraction = fp_to_double (filter_index) ;
-		indx = fp_to_int (filter_index) ;
-
-		icoeff = filter->coeffs [indx] + fraction * (filter->coeffs [indx + 1] - filter->coeffs [indx]) ;
-
-		right [0] += icoeff * filter->buffer [data_index] ;
-		right [1] += icoeff * filter->buffer [data_index + 1] ;
+{	double		left [2] = { 0.0, 0.0 }, right [2] = { 0.0, 0.0 } ;
 
-		filter_index -= increment ;
-		data_index = data_index - 2 ;
-		}
-	while (filter_index > MAKE_INCREMENT_T (0)) ;
+	calc_output_halves (filter, filter->dot->stereo, increment, start_filter_index, left, right) ;
 
 	output [0] = scale * (left [0] + right [0]) ;
 	output [1] = scale * (left [1] + right [1]) ;
@@ -485,58 +468,9 @@ sinc_stereo_vari_process (SRC_PRIVATE *psrc, SRC_DATA *data)
 
 static inline void
 calc_output_quad (SINC_FILTER *filter, increment_t increment, increment_t start_filter_index, double scale, float * output)
-{	double		fraction, left [4], right [4], icoeff ;
-	increment_t	filter_index, max_filter_index ;
-	int			data_index, coeff_count, indx ;
-
-	/* Convert input parameters into fixed point. */
-	max_filter_index = int_to_fp (filter->coeff_half_len) ;
+{	double		left [4] = { 0.0, 0.0, 0.0, 0.0 }, right [4] = { 0.0, 0.0, 0.0, 0.0 } ;
 
-	/* First apply the left half of the filter. */
-	filter_index = start_filter_index ;
-	coeff_count = (max_filter_index - filter_index) / increment ;
-	filter_index = filter_index + coeff_count * increment ;
-	data_index = filter->b_current - filter->channels * coeff_count ;
-
-	left [0] = left [1] = left [2] = left [3] = 0.0 ;
-	do
-	{	fraction = fp_to_double (filter_index) ;
-		indx = fp_to_int (filter_index) ;
-
-		icoeff = filter->coeffs [indx] + fraction * (filter->coeffs [indx + 1] - filter->coeffs [indx]) ;
-
-		left [0] += icoeff * filter->buffer [data_index] ;
-		left [1] += icoeff * filter->buffer [data_index + 1] ;
-		left [2] += icoeff * filter->buffer [data_index + 2] ;
-		left [3] += icoeff * filter->buffer [data_index + 3] ;
-
-		filter_index -= increment ;
-		data_index = data_index + 4 ;
-		}
-	while (filter_index >= MAKE_INCREMENT_T (0)) ;
-
-	/* Now apply the right half of the filter. */
-	filter_index = increment - start_filter_index ;
-	coeff_count = (max_filter_index - filter_index) / increment ;
-	filter_index = filter_index + coeff_count * increment ;
-	data_index = filter->b_current + filter->channels * (1 + coeff_count) ;
-
-	right [0] = right [1] = right [2] = right [3] = 0.0 ;
-	do
-	{	fraction = fp_to_double (filter_index) ;
-		indx = fp_to_int (filter_index) ;
-
-		icoeff = filter->coeffs [indx] + fraction * (filter->coeffs [indx + 1] - filter->coeffs [indx]) ;
-
-		right [0] += icoeff * filter->buffer [data_index] ;
-		right [1] += icoeff * filter->buffer [data_index + 1] ;
-		right [2] += icoeff * filter->buffer [data_index + 2] ;
-		right [3] += icoeff * filter->buffer [data_index + 3] ;
-
-		filter_index -= increment ;
-		data_index = data_index - 4 ;
-		}
-	while (filter_index > MAKE_INCREMENT_T (0)) ;
+	calc_output_halves (filter, filter->dot->quad, increment, start_filter_index, left, right) ;
 
 	output [0] = scale * (left [0] + right [0]) ;
 	output [1] = scale * (left [1] + right [1]) ;
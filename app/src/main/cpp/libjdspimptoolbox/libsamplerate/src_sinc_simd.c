@@ -0,0 +1,312 @@
+/*
+** Vectorised dot products for the sinc converter, see src_sinc_simd.h.
+**
+** x86 builds always have SSE2 and pick AVX at runtime when the CPU has it,
+** aarch64 builds use NEON. 32 bit ARM has no double precision vectors and
+** keeps the scalar code.
+*/
+
+#include <stddef.h>
+
+#include "src_sinc_simd.h"
+
+#if defined (__x86_64__) || defined (__i386__)
+#include <immintrin.h>
+#define SINC_SIMD_X86 1
+#elif defined (__aarch64__)
+#include <arm_neon.h>
+#define SINC_SIMD_NEON 1
+#endif
+
+/*========================================================================================
+**	Scalar reference.
+*/
+
+static void
+dot_mono_scalar (const double *coeff, const float *data, int taps, double *acc)
+{	double sum = 0.0 ;
+	int k ;
+
+	for (k = 0 ; k < taps ; k++)
+		sum += coeff [k] * data [k] ;
+
+	acc [0] += sum ;
+} /* dot_mono_scalar */
+
+static void
+dot_stereo_scalar (const double *coeff, const float *data, int taps, double *acc)
+{	double s0 = 0.0, s1 = 0.0 ;
+	int k ;
+
+	for (k = 0 ; k < taps ; k++)
+	{	s0 += coeff [k] * data [2 * k] ;
+		s1 += coeff [k] * data [2 * k + 1] ;
+		} ;
+
+	acc [0] += s0 ;
+	acc [1] += s1 ;
+} /* dot_stereo_scalar */
+
+static void
+dot_quad_scalar (const double *coeff, const float *data, int taps, double *acc)
+{	double s0 = 0.0, s1 = 0.0, s2 = 0.0, s3 = 0.0 ;
+	int k ;
+
+	for (k = 0 ; k < taps ; k++)
+	{	s0 += coeff [k] * data [4 * k] ;
+		s1 += coeff [k] * data [4 * k + 1] ;
+		s2 += coeff [k] * data [4 * k + 2] ;
+		s3 += coeff [k] * data [4 * k + 3] ;
+		} ;
+
+	acc [0] += s0 ;
+	acc [1] += s1 ;
+	acc [2] += s2 ;
+	acc [3] += s3 ;
+} /* dot_quad_scalar */
+
+static const SINC_DOT_FUNCS scalar_funcs = { dot_mono_scalar, dot_stereo_scalar, dot_quad_scalar, "scalar" } ;
+
+const SINC_DOT_FUNCS *
+sinc_dot_funcs_scalar (void)
+{	return &scalar_funcs ;
+} /* sinc_dot_funcs_scalar */
+
+/*========================================================================================
+**	SSE2 / AVX.
+*/
+
+#ifdef SINC_SIMD_X86
+
+static inline __m128d
+load2_ps_as_pd (const float *p)
+{	return _mm_cvtps_pd (_mm_castpd_ps (_mm_load_sd ((const double *) p))) ;
+} /* load2_ps_as_pd */
+
+static void
+dot_mono_sse2 (const double *coeff, const float *data, int taps, double *acc)
+{	__m128d s0 = _mm_setzero_pd (), s1 = _mm_setzero_pd () ;
+	double sum [2] ;
+	int k = 0 ;
+
+	for ( ; k + 4 <= taps ; k += 4)
+	{	s0 = _mm_add_pd (s0, _mm_mul_pd (_mm_loadu_pd (coeff + k), load2_ps_as_pd (data + k))) ;
+		s1 = _mm_add_pd (s1, _mm_mul_pd (_mm_loadu_pd (coeff + k + 2), load2_ps_as_pd (data + k + 2))) ;
+		} ;
+
+	_mm_storeu_pd (sum, _mm_add_pd (s0, s1)) ;
+	sum [0] += sum [1] ;
+	for ( ; k < taps ; k++)
+		sum [0] += coeff [k] * data [k] ;
+
+	acc [0] += sum [0] ;
+} /* dot_mono_sse2 */
+
+static void
+dot_stereo_sse2 (const double *coeff, const float *data, int taps, double *acc)
+{	__m128d s0 = _mm_setzero_pd (), s1 = _mm_setzero_pd () ;
+	double sum [2] ;
+	int k = 0 ;
+
+	for ( ; k + 2 <= taps ; k += 2)
+	{	s0 = _mm_add_pd (s0, _mm_mul_pd (_mm_set1_pd (coeff [k]), load2_ps_as_pd (data + 2 * k))) ;
+		s1 = _mm_add_pd (s1, _mm_mul_pd (_mm_set1_pd (coeff [k + 1]), load2_ps_as_pd (data + 2 * k + 2))) ;
+		} ;
+	for ( ; k < taps ; k++)
+		s0 = _mm_add_pd (s0, _mm_mul_pd (_mm_set1_pd (coeff [k]), load2_ps_as_pd (data + 2 * k))) ;
+
+	_mm_storeu_pd (sum, _mm_add_pd (s0, s1)) ;
+	acc [0] += sum [0] ;
+	acc [1] += sum [1] ;
+} /* dot_stereo_sse2 */
+
+static void
+dot_quad_sse2 (const double *coeff, const float *data, int taps, double *acc)
+{	__m128d lo = _mm_setzero_pd (), hi = _mm_setzero_pd () ;
+	double sum [4] ;
+	int k ;
+
+	for (k = 0 ; k < taps ; k++)
+	{	__m128 x = _mm_loadu_ps (data + 4 * k) ;
+		__m128d c = _mm_set1_pd (coeff [k]) ;
+
+		lo = _mm_add_pd (lo, _mm_mul_pd (c, _mm_cvtps_pd (x))) ;
+		hi = _mm_add_pd (hi, _mm_mul_pd (c, _mm_cvtps_pd (_mm_movehl_ps (x, x)))) ;
+		} ;
+
+	_mm_storeu_pd (sum, lo) ;
+	_mm_storeu_pd (sum + 2, hi) ;
+	acc [0] += sum [0] ;
+	acc [1] += sum [1] ;
+	acc [2] += sum [2] ;
+	acc [3] += sum [3] ;
+} /* dot_quad_sse2 */
+
+__attribute__ ((target ("avx"))) static void
+dot_mono_avx (const double *coeff, const float *data, int taps, double *acc)
+{	__m256d s0 = _mm256_setzero_pd (), s1 = _mm256_setzero_pd () ;
+	double sum [4] ;
+	int k = 0 ;
+
+	for ( ; k + 8 <= taps ; k += 8)
+	{	s0 = _mm256_add_pd (s0, _mm256_mul_pd (_mm256_loadu_pd (coeff + k), _mm256_cvtps_pd (_mm_loadu_ps (data + k)))) ;
+		s1 = _mm256_add_pd (s1, _mm256_mul_pd (_mm256_loadu_pd (coeff + k + 4), _mm256_cvtps_pd (_mm_loadu_ps (data + k + 4)))) ;
+		} ;
+
+	_mm256_storeu_pd (sum, _mm256_add_pd (s0, s1)) ;
+	sum [0] += sum [1] + sum [2] + sum [3] ;
+	for ( ; k < taps ; k++)
+		sum [0] += coeff [k] * data [k] ;
+
+	acc [0] += sum [0] ;
+} /* dot_mono_avx */
+
+__attribute__ ((target ("avx"))) static void
+dot_stereo_avx (const double *coeff, const float *data, int taps, double *acc)
+{	__m256d s = _mm256_setzero_pd () ;
+	double sum [4] ;
+	int k = 0 ;
+
+	/* Two frames per step: { L0, R0, L1, R1 } * { c0, c0, c1, c1 } */
+	for ( ; k + 2 <= taps ; k += 2)
+	{	__m256d c = _mm256_insertf128_pd (_mm256_castpd128_pd256 (_mm_set1_pd (coeff [k])), _mm_set1_pd (coeff [k + 1]), 1) ;
+
+		s = _mm256_add_pd (s, _mm256_mul_pd (c, _mm256_cvtps_pd (_mm_loadu_ps (data + 2 * k)))) ;
+		} ;
+
+	_mm256_storeu_pd (sum, s) ;
+	sum [0] += sum [2] ;
+	sum [1] += sum [3] ;
+	for ( ; k < taps ; k++)
+	{	sum [0] += coeff [k] * data [2 * k] ;
+		sum [1] += coeff [k] * data [2 * k + 1] ;
+		} ;
+
+	acc [0] += sum [0] ;
+	acc [1] += sum [1] ;
+} /* dot_stereo_avx */
+
+__attribute__ ((target ("avx"))) static void
+dot_quad_avx (const double *coeff, const float *data, int taps, double *acc)
+{	__m256d s0 = _mm256_setzero_pd (), s1 = _mm256_setzero_pd () ;
+	double sum [4], tmp [4] ;
+	int k = 0 ;
+
+	for ( ; k + 2 <= taps ; k += 2)
+	{	s0 = _mm256_add_pd (s0, _mm256_mul_pd (_mm256_broadcast_sd (coeff + k), _mm256_cvtps_pd (_mm_loadu_ps (data + 4 * k)))) ;
+		s1 = _mm256_add_pd (s1, _mm256_mul_pd (_mm256_broadcast_sd (coeff + k + 1), _mm256_cvtps_pd (_mm_loadu_ps (data + 4 * k + 4)))) ;
+		} ;
+	for ( ; k < taps ; k++)
+		s0 = _mm256_add_pd (s0, _mm256_mul_pd (_mm256_broadcast_sd (coeff + k), _mm256_cvtps_pd (_mm_loadu_ps (data + 4 * k)))) ;
+
+	_mm256_storeu_pd (sum, s0) ;
+	_mm256_storeu_pd (tmp, s1) ;
+	acc [0] += sum [0] + tmp [0] ;
+	acc [1] += sum [1] + tmp [1] ;
+	acc [2] += sum [2] + tmp [2] ;
+	acc [3] += sum [3] + tmp [3] ;
+} /* dot_quad_avx */
+
+static const SINC_DOT_FUNCS sse2_funcs = { dot_mono_sse2, dot_stereo_sse2, dot_quad_sse2, "sse2" } ;
+static const SINC_DOT_FUNCS avx_funcs = { dot_mono_avx, dot_stereo_avx, dot_quad_avx, "avx" } ;
+
+static const SINC_DOT_FUNCS *
+select_funcs (void)
+{	__builtin_cpu_init () ;
+	if (__builtin_cpu_supports ("avx"))
+		return &avx_funcs ;
+	return &sse2_funcs ;
+} /* select_funcs */
+
+#elif defined (SINC_SIMD_NEON)
+
+/*========================================================================================
+**	NEON (aarch64).
+*/
+
+static void
+dot_mono_neon (const double *coeff, const float *data, int taps, double *acc)
+{	float64x2_t s0 = vdupq_n_f64 (0.0), s1 = vdupq_n_f64 (0.0) ;
+	double sum ;
+	int k = 0 ;
+
+	for ( ; k + 4 <= taps ; k += 4)
+	{	float32x4_t x = vld1q_f32 (data + k) ;
+
+		s0 = vfmaq_f64 (s0, vld1q_f64 (coeff + k), vcvt_f64_f32 (vget_low_f32 (x))) ;
+		s1 = vfmaq_f64 (s1, vld1q_f64 (coeff + k + 2), vcvt_high_f64_f32 (x)) ;
+		} ;
+
+	sum = vaddvq_f64 (vaddq_f64 (s0, s1)) ;
+	for ( ; k < taps ; k++)
+		sum += coeff [k] * data [k] ;
+
+	acc [0] += sum ;
+} /* dot_mono_neon */
+
+static void
+dot_stereo_neon (const double *coeff, const float *data, int taps, double *acc)
+{	float64x2_t s0 = vdupq_n_f64 (0.0), s1 = vdupq_n_f64 (0.0) ;
+	int k = 0 ;
+
+	for ( ; k + 2 <= taps ; k += 2)
+	{	float32x4_t x = vld1q_f32 (data + 2 * k) ;
+
+		s0 = vfmaq_n_f64 (s0, vcvt_f64_f32 (vget_low_f32 (x)), coeff [k]) ;
+		s1 = vfmaq_n_f64 (s1, vcvt_high_f64_f32 (x), coeff [k + 1]) ;
+		} ;
+	for ( ; k < taps ; k++)
+		s0 = vfmaq_n_f64 (s0, vcvt_f64_f32 (vld1_f32 (data + 2 * k)), coeff [k]) ;
+
+	s0 = vaddq_f64 (s0, s1) ;
+	acc [0] += vgetq_lane_f64 (s0, 0) ;
+	acc [1] += vgetq_lane_f64 (s0, 1) ;
+} /* dot_stereo_neon */
+
+static void
+dot_quad_neon (const double *coeff, const float *data, int taps, double *acc)
+{	float64x2_t lo = vdupq_n_f64 (0.0), hi = vdupq_n_f64 (0.0) ;
+	int k ;
+
+	for (k = 0 ; k < taps ; k++)
+	{	float32x4_t x = vld1q_f32 (data + 4 * k) ;
+
+		lo = vfmaq_n_f64 (lo, vcvt_f64_f32 (vget_low_f32 (x)), coeff [k]) ;
+		hi = vfmaq_n_f64 (hi, vcvt_high_f64_f32 (x), coeff [k]) ;
+		} ;
+
+	acc [0] += vgetq_lane_f64 (lo, 0) ;
+	acc [1] += vgetq_lane_f64 (lo, 1) ;
+	acc [2] += vgetq_lane_f64 (hi, 0) ;
+	acc [3] += vgetq_lane_f64 (hi, 1) ;
+} /* dot_quad_neon */
+
+static const SINC_DOT_FUNCS neon_funcs = { dot_mono_neon, dot_stereo_neon, dot_quad_neon, "neon" } ;
+
+static const SINC_DOT_FUNCS *
+select_funcs (void)
+{	return &neon_funcs ;
+} /* select_funcs */
+
+#else
+
+static const SINC_DOT_FUNCS *
+select_funcs (void)
+{	return &scalar_funcs ;
+} /* select_funcs */
+
+#endif
+
+const SINC_DOT_FUNCS *
+sinc_dot_funcs (void)
+{	/* Every thread computes the same answer, so a racy first call is harmless. */
+	static const SINC_DOT_FUNCS *selected = NULL ;
+	const SINC_DOT_FUNCS *funcs = __atomic_load_n (&selected, __ATOMIC_ACQUIRE) ;
+
+	if (funcs == NULL)
+	{	funcs = select_funcs () ;
+		__atomic_store_n (&selected, funcs, __ATOMIC_RELEASE) ;
+		} ;
+
+	return funcs ;
+} /* sinc_dot_funcs */
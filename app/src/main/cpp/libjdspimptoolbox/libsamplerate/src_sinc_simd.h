@@ -0,0 +1,29 @@
+/*
+** Vectorised dot products for the sinc converter.
+**
+** The converter first interpolates a block of filter coefficients and then
+** hands it to one of these kernels together with the interleaved input:
+**
+**     acc [c] += sum_k coeff [k] * data [k * channels + c]
+**
+** Accumulation is done in double precision like the scalar code, only the
+** summation order differs.
+*/
+
+#ifndef SRC_SINC_SIMD_H_INCLUDED
+#define SRC_SINC_SIMD_H_INCLUDED
+
+typedef void (*sinc_dot_func) (const double *coeff, const float *data, int taps, double *acc) ;
+
+typedef struct
+{	sinc_dot_func	mono, stereo, quad ;
+	const char		*name ;
+} SINC_DOT_FUNCS ;
+
+/* Best implementation for the running CPU, selected once. */
+const SINC_DOT_FUNCS *sinc_dot_funcs (void) ;
+
+/* Portable C reference implementation. */
+const SINC_DOT_FUNCS *sinc_dot_funcs_scalar (void) ;
+
+#endif /* SRC_SINC_SIMD_H_INCLUDED */
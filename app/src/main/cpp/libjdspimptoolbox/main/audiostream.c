@@ -0,0 +1,233 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "audiostream.h"
+#include "../libsamplerate/samplerate.h"
+#include "../dr_mp3.h"
+#include "../dr_flac.h"
+#include "../dr_wav.h"
+
+enum
+{
+	AUDIOSTREAM_WAV = 0,
+	AUDIOSTREAM_FLAC = 1,
+	AUDIOSTREAM_MP3 = 2
+};
+static int audioStreamFileType(const char *filename)
+{
+	const char *dot = strrchr(filename, '.');
+	if (!dot || dot == filename)
+		return -1;
+	const char *ext = dot + 1;
+	if (!strncmp(ext, "wav", 5) || !strncmp(ext, "irs", 5))
+		return AUDIOSTREAM_WAV;
+	if (!strncmp(ext, "flac", 5))
+		return AUDIOSTREAM_FLAC;
+	if (!strncmp(ext, "mp3", 5))
+		return AUDIOSTREAM_MP3;
+	return -1;
+}
+static uint64_t readAudioStreamDecoder(audioStream *st, uint64_t frames, float *out)
+{
+	switch (st->type)
+	{
+	case AUDIOSTREAM_WAV:
+		return drwav_read_pcm_frames_f32((drwav*)st->decoder, frames, out);
+	case AUDIOSTREAM_FLAC:
+		return drflac_read_pcm_frames_f32((drflac*)st->decoder, frames, out);
+	case AUDIOSTREAM_MP3:
+		return drmp3_read_pcm_frames_f32((drmp3*)st->decoder, frames, out);
+	default:
+		return 0;
+	}
+}
+uint64_t readAudioStreamFrames(audioStream *st, uint64_t frames, float *out)
+{
+	return readAudioStreamDecoder(st, frames, out);
+}
+static void closeAudioStreamDecoder(audioStream *st)
+{
+	if (!st->decoder)
+		return;
+	switch (st->type)
+	{
+	case AUDIOSTREAM_WAV:
+		drwav_uninit((drwav*)st->decoder);
+		free(st->decoder);
+		break;
+	case AUDIOSTREAM_FLAC:
+		drflac_close((drflac*)st->decoder);
+		break;
+	case AUDIOSTREAM_MP3:
+		drmp3_uninit((drmp3*)st->decoder);
+		free(st->decoder);
+		break;
+	}
+	st->decoder = 0;
+}
+int openAudioStream(audioStream *st, const char *filename, double targetFs, int resampleQuality)
+{
+	memset(st, 0, sizeof(audioStream));
+	st->type = audioStreamFileType(filename);
+	st->resampleQuality = resampleQuality;
+	if (st->type == AUDIOSTREAM_WAV)
+	{
+		drwav *wav = (drwav*)malloc(sizeof(drwav));
+		if (!wav || !drwav_init_file(wav, filename, 0))
+		{
+			free(wav);
+			return -1;
+		}
+		st->decoder = wav;
+		st->channels = wav->channels;
+		st->sampleRate = wav->sampleRate;
+		st->inputFrames = wav->totalPCMFrameCount;
+	}
+	else if (st->type == AUDIOSTREAM_FLAC)
+	{
+		drflac *flac = drflac_open_file(filename, 0);
+		if (!flac)
+			return -1;
+		st->decoder = flac;
+		st->channels = flac->channels;
+		st->sampleRate = flac->sampleRate;
+		st->inputFrames = flac->totalPCMFrameCount;
+	}
+	else if (st->type == AUDIOSTREAM_MP3)
+	{
+		drmp3 *mp3 = (drmp3*)malloc(sizeof(drmp3));
+		if (!mp3 || !drmp3_init_file(mp3, filename, 0))
+		{
+			free(mp3);
+			return -1;
+		}
+		st->decoder = mp3;
+		st->channels = mp3->channels;
+		st->sampleRate = mp3->sampleRate;
+		// Scans frame headers and seeks back, no PCM is retained
+		st->inputFrames = drmp3_get_pcm_frame_count(mp3);
+	}
+	else
+	{
+		printf("Unsupported audio file type");
+		return -1;
+	}
+	// Sanity check
+	if (st->channels < 1 || st->sampleRate < 1 || st->inputFrames < 1)
+	{
+		printf("Invalid audio channels count / sample rate / frame count");
+		closeAudioStream(st);
+		return -1;
+	}
+	st->ratio = targetFs / (double)st->sampleRate;
+	st->outputFrames = st->ratio != 1.0 ? (uint64_t)ceil(st->inputFrames * st->ratio) : st->inputFrames;
+	st->decodeBuf = (float*)malloc(AUDIOSTREAM_CHUNK_FRAMES * st->channels * sizeof(float));
+	if (!st->decodeBuf)
+	{
+		closeAudioStream(st);
+		return -1;
+	}
+	// Negative quality opens the decoder only, the caller resamples on its own
+	if (resampleQuality >= 0 && st->ratio != 1.0 && !(st->inputFrames == 1 && st->outputFrames == 1))
+	{
+		int error;
+		st->src = src_new(resampleQuality, st->channels, &error);
+		st->resampleBufFrames = (size_t)ceil(AUDIOSTREAM_CHUNK_FRAMES * st->ratio) + 16;
+		st->resampleBuf = (float*)malloc(st->resampleBufFrames * st->channels * sizeof(float));
+		if (!st->src || !st->resampleBuf)
+		{
+			closeAudioStream(st);
+			return -1;
+		}
+	}
+	return 0;
+}
+static size_t scatterPlanar(const float *in, size_t frames, unsigned int channels, float **out, size_t offset, size_t capacity)
+{
+	if (offset >= capacity)
+		return 0;
+	if (frames > capacity - offset)
+		frames = capacity - offset;
+	for (unsigned int c = 0; c < channels; c++)
+	{
+		float *dst = out[c] + offset;
+		const float *src = in + c;
+		for (size_t i = 0; i < frames; i++)
+			dst[i] = src[i * channels];
+	}
+	return frames;
+}
+size_t readAudioStreamPlanar(audioStream *st, float **out)
+{
+	const size_t capacity = (size_t)st->outputFrames;
+	size_t written = 0;
+	uint64_t consumed = 0;
+	if (!st->src)
+	{
+		while (written < capacity)
+		{
+			uint64_t n = readAudioStreamDecoder(st, AUDIOSTREAM_CHUNK_FRAMES, st->decodeBuf);
+			if (!n)
+				break;
+			written += scatterPlanar(st->decodeBuf, (size_t)n, st->channels, out, written, capacity);
+		}
+	}
+	else
+	{
+		SRC_DATA data;
+		memset(&data, 0, sizeof(data));
+		data.src_ratio = st->ratio;
+		int eof = 0;
+		while (!eof)
+		{
+			uint64_t n = readAudioStreamDecoder(st, AUDIOSTREAM_CHUNK_FRAMES, st->decodeBuf);
+			consumed += n;
+			eof = n < AUDIOSTREAM_CHUNK_FRAMES || consumed >= st->inputFrames;
+			data.data_in = st->decodeBuf;
+			data.input_frames = (long)n;
+			data.end_of_input = eof;
+			for (;;)
+			{
+				data.data_out = st->resampleBuf;
+				data.output_frames = (long)st->resampleBufFrames;
+				if (src_process((SRC_STATE*)st->src, &data))
+				{
+					eof = 1;
+					break;
+				}
+				written += scatterPlanar(st->resampleBuf, (size_t)data.output_frames_gen, st->channels, out, written, capacity);
+				data.data_in += data.input_frames_used * st->channels;
+				data.input_frames -= data.input_frames_used;
+				if (written >= capacity)
+				{
+					eof = 1;
+					break;
+				}
+				if (data.input_frames > 0)
+				{
+					if (!data.input_frames_used && !data.output_frames_gen)
+						break;
+					continue;
+				}
+				// Input exhausted: keep draining the filter tail only at end of stream
+				if (!eof || !data.output_frames_gen)
+					break;
+			}
+		}
+	}
+	for (unsigned int c = 0; c < st->channels; c++)
+		memset(out[c] + written, 0, (capacity - written) * sizeof(float));
+	return written;
+}
+void closeAudioStream(audioStream *st)
+{
+	closeAudioStreamDecoder(st);
+	if (st->src)
+		src_delete((SRC_STATE*)st->src);
+	st->src = 0;
+	free(st->decodeBuf);
+	free(st->resampleBuf);
+	st->decodeBuf = 0;
+	st->resampleBuf = 0;
+}
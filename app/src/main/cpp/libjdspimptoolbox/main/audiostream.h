@@ -0,0 +1,35 @@
+#ifndef __AUDIOSTREAM_H__
+#define __AUDIOSTREAM_H__
+#include <stddef.h>
+#include <stdint.h>
+// Chunked decoder -> resampler pipeline.
+// Audio files are decoded in small blocks and fed through a persistent SRC_STATE, so the only
+// buffer that ever scales with the file length is the one the caller hands in to receive the result.
+#define AUDIOSTREAM_CHUNK_FRAMES 4096
+typedef struct
+{
+	int type;
+	void *decoder;
+	unsigned int channels;
+	unsigned int sampleRate;
+	uint64_t inputFrames;
+	uint64_t outputFrames;
+	double ratio;
+	int resampleQuality;
+	void *src;
+	float *decodeBuf;
+	float *resampleBuf;
+	size_t resampleBufFrames;
+} audioStream;
+// Opens and probes a wav/irs/flac/mp3 file. Returns 0 on success.
+// outputFrames is the exact number of frames readAudioStreamPlanar() will produce at targetFs.
+// A negative resampleQuality only opens the decoder, use readAudioStreamFrames() then.
+int openAudioStream(audioStream *st, const char *filename, double targetFs, int resampleQuality);
+// Decodes and resamples the whole file into per-channel buffers that hold at least outputFrames
+// samples each. Frames the resampler does not produce (filter tail) are zero filled.
+// Returns the number of frames actually generated.
+size_t readAudioStreamPlanar(audioStream *st, float **out);
+// Decodes up to frames interleaved frames at the source rate, returns the number decoded
+uint64_t readAudioStreamFrames(audioStream *st, uint64_t frames, float *out);
+void closeAudioStream(audioStream *st);
+#endif /* __AUDIOSTREAM_H__ */
@@ -0,0 +1,165 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cpthread.h"
+#include "coeffcache.h"
+
+typedef struct coeffCacheEntry
+{
+	struct coeffCacheEntry *prev, *next; // Most recently used first
+	int effect;
+	uint64_t paramHash;
+	int sampleRate;
+	size_t size;
+	float payload[]; // Float aligned, every user stores float data
+} coeffCacheEntry;
+typedef struct
+{
+	pthread_mutex_t lock;
+	coeffCacheEntry *head, *tail;
+	size_t bytes, budget;
+	uint64_t entries, hits, misses, evictions;
+} coeffCache;
+static coeffCache cache;
+static pthread_once_t cacheOnce = PTHREAD_ONCE_INIT;
+
+static void coeffCacheInit(void)
+{
+	pthread_mutex_init(&cache.lock, 0);
+	cache.budget = COEFFCACHE_DEFAULT_BUDGET;
+}
+uint64_t coeffCacheHash(const void *data, size_t len, uint64_t seed)
+{
+	const unsigned char *p = (const unsigned char*)data;
+	uint64_t h = seed;
+	for (size_t i = 0; i < len; i++)
+	{
+		h ^= p[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+static void coeffCacheUnlink(coeffCacheEntry *e)
+{
+	if (e->prev)
+		e->prev->next = e->next;
+	else
+		cache.head = e->next;
+	if (e->next)
+		e->next->prev = e->prev;
+	else
+		cache.tail = e->prev;
+	e->prev = e->next = 0;
+}
+static void coeffCachePushFront(coeffCacheEntry *e)
+{
+	e->prev = 0;
+	e->next = cache.head;
+	if (cache.head)
+		cache.head->prev = e;
+	cache.head = e;
+	if (!cache.tail)
+		cache.tail = e;
+}
+static void coeffCacheRemove(coeffCacheEntry *e)
+{
+	coeffCacheUnlink(e);
+	cache.bytes -= e->size;
+	cache.entries--;
+	free(e);
+}
+static coeffCacheEntry *coeffCacheFind(int effect, uint64_t paramHash, int sampleRate)
+{
+	for (coeffCacheEntry *e = cache.head; e; e = e->next)
+		if (e->effect == effect && e->paramHash == paramHash && e->sampleRate == sampleRate)
+			return e;
+	return 0;
+}
+static void coeffCacheTrim(size_t budget)
+{
+	while (cache.tail && cache.bytes > budget)
+	{
+		coeffCacheRemove(cache.tail);
+		cache.evictions++;
+	}
+}
+void *coeffCacheLookup(int effect, uint64_t paramHash, int sampleRate, size_t *size)
+{
+	pthread_once(&cacheOnce, coeffCacheInit);
+	void *copy = 0;
+	pthread_mutex_lock(&cache.lock);
+	coeffCacheEntry *e = coeffCacheFind(effect, paramHash, sampleRate);
+	if (e)
+	{
+		copy = malloc(e->size ? e->size : 1);
+		if (copy)
+		{
+			memcpy(copy, e->payload, e->size);
+			*size = e->size;
+			coeffCacheUnlink(e);
+			coeffCachePushFront(e);
+		}
+	}
+	if (copy)
+		cache.hits++;
+	else
+		cache.misses++;
+	pthread_mutex_unlock(&cache.lock);
+	return copy;
+}
+int coeffCacheStore(int effect, uint64_t paramHash, int sampleRate, const void *data, size_t size)
+{
+	pthread_once(&cacheOnce, coeffCacheInit);
+	// Copy outside the lock, payloads can be several megabytes
+	coeffCacheEntry *e = (coeffCacheEntry*)malloc(sizeof(coeffCacheEntry) + size);
+	if (!e)
+		return -1;
+	e->effect = effect;
+	e->paramHash = paramHash;
+	e->sampleRate = sampleRate;
+	e->size = size;
+	memcpy(e->payload, data, size);
+	pthread_mutex_lock(&cache.lock);
+	coeffCacheEntry *old = coeffCacheFind(effect, paramHash, sampleRate);
+	if (old)
+		coeffCacheRemove(old);
+	if (size > cache.budget)
+	{
+		pthread_mutex_unlock(&cache.lock);
+		free(e);
+		return -1;
+	}
+	coeffCacheTrim(cache.budget - size);
+	coeffCachePushFront(e);
+	cache.bytes += size;
+	cache.entries++;
+	pthread_mutex_unlock(&cache.lock);
+	return 0;
+}
+void coeffCacheSetBudget(size_t bytes)
+{
+	pthread_once(&cacheOnce, coeffCacheInit);
+	pthread_mutex_lock(&cache.lock);
+	cache.budget = bytes;
+	coeffCacheTrim(bytes);
+	pthread_mutex_unlock(&cache.lock);
+}
+void coeffCacheGetStats(coeffCacheStats *stats)
+{
+	pthread_once(&cacheOnce, coeffCacheInit);
+	pthread_mutex_lock(&cache.lock);
+	stats->hits = cache.hits;
+	stats->misses = cache.misses;
+	stats->evictions = cache.evictions;
+	stats->entries = cache.entries;
+	stats->bytes = cache.bytes;
+	stats->budget = cache.budget;
+	pthread_mutex_unlock(&cache.lock);
+}
+void coeffCacheClear(void)
+{
+	pthread_once(&cacheOnce, coeffCacheInit);
+	pthread_mutex_lock(&cache.lock);
+	while (cache.head)
+		coeffCacheRemove(cache.head);
+	pthread_mutex_unlock(&cache.lock);
+}
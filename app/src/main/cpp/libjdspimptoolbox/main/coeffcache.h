@@ -0,0 +1,29 @@
+#ifndef __COEFFCACHE_H__
+#define __COEFFCACHE_H__
+#include <stddef.h>
+#include <stdint.h>
+// Process-wide cache of designed coefficient sets and resampled impulse responses.
+// Entries are keyed by (effect, parameter hash, sample rate), so switching back to a recently used
+// output rate becomes a lookup instead of a redesign. Least recently used entries are dropped once
+// the total payload exceeds the byte budget. All functions are thread safe.
+#define COEFFCACHE_EFFECT_CONVOLVER_IR 1
+// Measured response matrix of the parameter-only libjamesdsp stages on a display grid (chain preview)
+#define COEFFCACHE_EFFECT_CHAIN_STAGES 2
+#define COEFFCACHE_DEFAULT_BUDGET (16u * 1024u * 1024u)
+typedef struct
+{
+	uint64_t hits, misses, evictions;
+	uint64_t entries, bytes, budget;
+} coeffCacheStats;
+// 64 bit FNV-1a, chain calls through seed to hash several fields. Start with COEFFCACHE_HASH_SEED.
+#define COEFFCACHE_HASH_SEED 0xcbf29ce484222325ULL
+uint64_t coeffCacheHash(const void *data, size_t len, uint64_t seed);
+// Returns a malloc'ed copy of the entry the caller frees, or NULL on a miss. *size receives the payload size.
+void *coeffCacheLookup(int effect, uint64_t paramHash, int sampleRate, size_t *size);
+// Stores a copy of data, replacing an entry with the same key. Returns 0 if it was cached.
+int coeffCacheStore(int effect, uint64_t paramHash, int sampleRate, const void *data, size_t size);
+// Shrinking the budget evicts immediately, 0 disables caching
+void coeffCacheSetBudget(size_t bytes);
+void coeffCacheGetStats(coeffCacheStats *stats);
+void coeffCacheClear(void);
+#endif /* __COEFFCACHE_H__ */
@@ -27,6 +27,20 @@ int pthread_detach(pthread_t thread)
 {
     CloseHandle(thread);
 }
+// One-time initialization
+static BOOL CALLBACK pthread_once_trampoline(PINIT_ONCE once, PVOID param, PVOID *context)
+{
+    (void)once;
+    (void)context;
+    ((void (*)(void))param)();
+    return TRUE;
+}
+int pthread_once(pthread_once_t *once_control, void (*init_routine)(void))
+{
+    if (once_control == NULL || init_routine == NULL)
+        return 1;
+    return !InitOnceExecuteOnce(once_control, pthread_once_trampoline, (PVOID)init_routine, NULL);
+}
 // Mutex
 int pthread_mutex_init(pthread_mutex_t *mutex, pthread_mutexattr_t *attr)
 {
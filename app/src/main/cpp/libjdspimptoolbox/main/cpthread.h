@@ -10,6 +10,8 @@ typedef void pthread_condattr_t;
 typedef void pthread_rwlockattr_t;
 typedef HANDLE pthread_t;
 typedef CONDITION_VARIABLE pthread_cond_t;
+typedef INIT_ONCE pthread_once_t;
+#define PTHREAD_ONCE_INIT INIT_ONCE_STATIC_INIT
 typedef struct
 {
 	SRWLOCK lock;
@@ -19,6 +21,7 @@ int pthread_create(pthread_t *thread, pthread_attr_t *attr, void *(*start_routin
 void pthread_exit(void *value_ptr);
 int pthread_join(pthread_t thread, void **value_ptr);
 int pthread_detach(pthread_t);
+int pthread_once(pthread_once_t *once_control, void (*init_routine)(void));
 
 int pthread_mutex_init(pthread_mutex_t *mutex, pthread_mutexattr_t *attr);
 int pthread_mutex_destroy(pthread_mutex_t *mutex);
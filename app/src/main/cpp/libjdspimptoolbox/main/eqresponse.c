@@ -0,0 +1,213 @@
+#include <stdlib.h>
+#include <string.h>
+#include "cpthread.h"
+#include "threadpool.h"
+#include "eqresponse.h"
+
+#define EQRESPONSE_POOL_SIZE 4
+#define EQRESPONSE_GUARD_FREQ 24000.0
+typedef struct
+{
+	pthread_mutex_t lock;
+	eqResponseCurve curves[EQRESPONSE_POOL_SIZE];
+	int ready[EQRESPONSE_POOL_SIZE];
+	unsigned int clock;
+} eqResponsePool;
+static eqResponsePool curvePool;
+static pthread_once_t curvePoolOnce = PTHREAD_ONCE_INIT;
+
+int eqResponseInit(eqResponseCurve *c)
+{
+	memset(c, 0, sizeof(eqResponseCurve));
+	initIerper(&c->lerp, EQRESPONSE_MAX_BANDS + 2);
+	return 0;
+}
+void eqResponseFree(eqResponseCurve *c)
+{
+	freeIerper(&c->lerp);
+	free(c->grid);
+	free(c->response);
+	c->grid = 0;
+	c->response = 0;
+	c->bands = 0;
+	c->gridLen = c->gridCap = c->responseValid = 0;
+}
+int eqResponseSetBands(eqResponseCurve *c, int mode, const double *freq, const double *gain, int bands)
+{
+	if (bands > EQRESPONSE_MAX_BANDS)
+		bands = EQRESPONSE_MAX_BANDS;
+	if (c->bands == bands && c->mode == mode && !memcmp(c->freq + 1, freq, bands * sizeof(double)) && !memcmp(c->gain + 1, gain, bands * sizeof(double)))
+		return 0;
+	memcpy(c->freq + 1, freq, bands * sizeof(double));
+	memcpy(c->gain + 1, gain, bands * sizeof(double));
+	c->freq[0] = 0.0;
+	c->gain[0] = c->gain[1];
+	c->freq[bands + 1] = EQRESPONSE_GUARD_FREQ;
+	c->gain[bands + 1] = c->gain[bands];
+	// pchip/makima may touch the point arrays, hand them a scratch copy so the comparison above stays exact
+	double x[EQRESPONSE_MAX_BANDS + 2], y[EQRESPONSE_MAX_BANDS + 2];
+	memcpy(x, c->freq, (bands + 2) * sizeof(double));
+	memcpy(y, c->gain, (bands + 2) * sizeof(double));
+	if (mode == EQRESPONSE_MAKIMA)
+		makima(&c->lerp, x, y, bands + 2, 1, 1);
+	else
+		pchip(&c->lerp, x, y, bands + 2, 1, 1);
+	c->mode = mode;
+	c->bands = bands;
+	c->responseValid = 0;
+	return 1;
+}
+double eqResponseValueAt(eqResponseCurve *c, double freq)
+{
+	return getValueAt(&c->lerp.cb, freq);
+}
+static void eqResponseEvaluateUncached(eqResponseCurve *c, const double *dispFreq, int nPts, float *response)
+{
+	for (int i = 0; i < nPts; i++)
+		response[i] = (float)getValueAt(&c->lerp.cb, dispFreq[i]);
+}
+void eqResponseEvaluate(eqResponseCurve *c, const double *dispFreq, int nPts, float *response)
+{
+	if (c->responseValid && c->gridLen == nPts && !memcmp(c->grid, dispFreq, nPts * sizeof(double)))
+	{
+		memcpy(response, c->response, nPts * sizeof(float));
+		return;
+	}
+	eqResponseEvaluateUncached(c, dispFreq, nPts, response);
+	if (nPts > c->gridCap)
+	{
+		double *grid = (double*)realloc(c->grid, nPts * sizeof(double));
+		if (grid)
+			c->grid = grid;
+		float *resp = (float*)realloc(c->response, nPts * sizeof(float));
+		if (resp)
+			c->response = resp;
+		if (!grid || !resp)
+		{
+			c->responseValid = 0;
+			return;
+		}
+		c->gridCap = nPts;
+	}
+	memcpy(c->grid, dispFreq, nPts * sizeof(double));
+	memcpy(c->response, response, nPts * sizeof(float));
+	c->gridLen = nPts;
+	c->responseValid = 1;
+}
+static void eqResponsePoolInit(void)
+{
+	pthread_mutex_init(&curvePool.lock, 0);
+}
+static int eqResponseHolds(const eqResponseCurve *c, int mode, const double *freq, const double *gain, int bands)
+{
+	return c->bands == bands && c->mode == mode && !memcmp(c->freq + 1, freq, bands * sizeof(double)) && !memcmp(c->gain + 1, gain, bands * sizeof(double));
+}
+eqResponseCurve *eqResponseAcquire(int mode, const double *freq, const double *gain, int bands)
+{
+	int i;
+	if (bands > EQRESPONSE_MAX_BANDS)
+		bands = EQRESPONSE_MAX_BANDS;
+	pthread_once(&curvePoolOnce, eqResponsePoolInit);
+	eqResponseCurve *c = 0;
+	pthread_mutex_lock(&curvePool.lock);
+	// Prefer the idle curve already holding this spline, then the least recently used idle one,
+	// then a slot whose interpolator was never allocated
+	int match = -1, lru = -1, fresh = -1;
+	for (i = 0; i < EQRESPONSE_POOL_SIZE; i++)
+	{
+		eqResponseCurve *p = &curvePool.curves[i];
+		if (!curvePool.ready[i])
+		{
+			if (fresh < 0)
+				fresh = i;
+		}
+		else if (!p->inUse)
+		{
+			if (eqResponseHolds(p, mode, freq, gain, bands))
+			{
+				match = i;
+				break;
+			}
+			if (lru < 0 || p->lastUse < curvePool.curves[lru].lastUse)
+				lru = i;
+		}
+	}
+	int slot = match >= 0 ? match : (lru >= 0 ? lru : fresh);
+	if (slot >= 0)
+	{
+		c = &curvePool.curves[slot];
+		if (!curvePool.ready[slot])
+		{
+			eqResponseInit(c);
+			curvePool.ready[slot] = 1;
+		}
+		c->pooled = 1;
+		c->inUse = 1;
+		c->lastUse = ++curvePool.clock;
+	}
+	pthread_mutex_unlock(&curvePool.lock);
+	if (!c)
+	{
+		c = (eqResponseCurve*)malloc(sizeof(eqResponseCurve));
+		if (!c)
+			return 0;
+		eqResponseInit(c);
+	}
+	eqResponseSetBands(c, mode, freq, gain, bands);
+	return c;
+}
+void eqResponseRelease(eqResponseCurve *c)
+{
+	if (!c)
+		return;
+	if (!c->pooled)
+	{
+		eqResponseFree(c);
+		free(c);
+		return;
+	}
+	pthread_mutex_lock(&curvePool.lock);
+	c->inUse = 0;
+	pthread_mutex_unlock(&curvePool.lock);
+}
+typedef struct
+{
+	eqResponseCurve *curves; // One per pool thread
+	int mode, bands, nPts;
+	const double *freq, *gain, *dispFreq;
+	float *response;
+} eqResponseBatchJob;
+static void eqResponseBatchTask(void *arg, int taskIdx, int threadIdx)
+{
+	eqResponseBatchJob *job = (eqResponseBatchJob*)arg;
+	eqResponseCurve *c = &job->curves[threadIdx];
+	eqResponseSetBands(c, job->mode, job->freq, job->gain + (size_t)taskIdx * job->bands, job->bands);
+	// Every task holds a different curve, nothing to gain from keeping the evaluation
+	eqResponseEvaluateUncached(c, job->dispFreq, job->nPts, job->response + (size_t)taskIdx * job->nPts);
+}
+int eqResponseBatch(int mode, const double *freq, const double *gain, int bands, int curves, const double *dispFreq, int nPts, float *response)
+{
+	int i;
+	if (bands < 2 || curves <= 0 || nPts <= 0)
+		return -1;
+	if (bands > EQRESPONSE_MAX_BANDS)
+		bands = EQRESPONSE_MAX_BANDS;
+	int threads = threadPoolSize();
+	eqResponseBatchJob job = { 0, mode, bands, nPts, freq, gain, dispFreq, response };
+	job.curves = (eqResponseCurve*)malloc(threads * sizeof(eqResponseCurve));
+	if (!job.curves)
+		return -1;
+	for (i = 0; i < threads; i++)
+		eqResponseInit(&job.curves[i]);
+	threadPoolParallelFor(eqResponseBatchTask, &job, curves);
+	for (i = 0; i < threads; i++)
+		eqResponseFree(&job.curves[i]);
+	free(job.curves);
+	return 0;
+}
+__attribute__((destructor)) static void eqResponsePoolDestruction(void)
+{
+	for (int i = 0; i < EQRESPONSE_POOL_SIZE; i++)
+		if (curvePool.ready[i])
+			eqResponseFree(&curvePool.curves[i]);
+}
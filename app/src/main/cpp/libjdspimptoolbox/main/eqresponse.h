@@ -0,0 +1,36 @@
+#ifndef __EQRESPONSE_H__
+#define __EQRESPONSE_H__
+#include <jdsp_header.h>
+// Reentrant evaluation of interpolated EQ/compander curves for the UI previews.
+// Every curve owns its interpolator, so concurrent previews no longer share spline state.
+// The spline is only rebuilt when the control points change, and the last display evaluation
+// is reused while neither the spline nor the display grid changed.
+#define EQRESPONSE_MAX_BANDS 15
+#define EQRESPONSE_PCHIP 0
+#define EQRESPONSE_MAKIMA 1
+typedef struct
+{
+	ierper lerp;
+	int mode, bands; // bands is 0 until the first spline was built
+	double freq[EQRESPONSE_MAX_BANDS + 2], gain[EQRESPONSE_MAX_BANDS + 2]; // Control points including the two guard points
+	double *grid; // Display frequencies of the cached evaluation
+	float *response;
+	int gridLen, gridCap, responseValid;
+	int pooled, inUse;
+	unsigned int lastUse;
+} eqResponseCurve;
+// Returns 0 on success
+int eqResponseInit(eqResponseCurve *c);
+void eqResponseFree(eqResponseCurve *c);
+// Sets bands control points, a guard point is added at 0 Hz and at 24 kHz. Returns 1 if the spline was rebuilt
+int eqResponseSetBands(eqResponseCurve *c, int mode, const double *freq, const double *gain, int bands);
+double eqResponseValueAt(eqResponseCurve *c, double freq);
+void eqResponseEvaluate(eqResponseCurve *c, const double *dispFreq, int nPts, float *response);
+// Hands out a curve of the process-wide pool, preferring one that already holds this spline.
+// Falls back to a private curve when all pooled curves are busy. Returns NULL if out of memory.
+eqResponseCurve *eqResponseAcquire(int mode, const double *freq, const double *gain, int bands);
+void eqResponseRelease(eqResponseCurve *c);
+// Evaluates curves curves that share the band frequencies across the thread pool.
+// gain holds bands values per curve, response nPts values per curve. Returns 0 on success
+int eqResponseBatch(int mode, const double *freq, const double *gain, int bands, int curves, const double *dispFreq, int nPts, float *response);
+#endif /* __EQRESPONSE_H__ */
@@ -0,0 +1,239 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <jdsp_header.h>
+#include "cpthread.h"
+#include "iirresponse.h"
+
+// Two doubles per vector: SSE2 on x86, NEON on arm64, split into scalar ops by the compiler on armv7
+typedef double iirVec __attribute__((vector_size(16)));
+typedef long long iirMask __attribute__((vector_size(16)));
+#define IIR_LANES 2
+static inline iirVec iirLoad(const double *p)
+{
+	iirVec v;
+	memcpy(&v, p, sizeof(v));
+	return v;
+}
+static inline void iirStore(double *p, iirVec v)
+{
+	memcpy(p, &v, sizeof(v));
+}
+static inline iirVec iirSplat(double x)
+{
+	iirVec v = { x, x };
+	return v;
+}
+
+typedef struct
+{
+	double param[5]; // Whatever identifies the term, compared bitwise
+	int valid;
+	double *re, *im;
+} iirTerm;
+typedef struct
+{
+	pthread_mutex_t lock;
+	double fs;
+	int nPts, padded, cap; // padded rounds nPts up to whole vectors, the tail repeats the last point
+	double *freq, *cosW, *sinW, *cos2W, *sin2W;
+	iirTerm term[IIRRESPONSE_MAX_SECTIONS];
+	double *accRe, *accIm;
+} iirPreviewCache;
+static iirPreviewCache shelfCache, bankCache;
+static pthread_once_t cacheOnce = PTHREAD_ONCE_INIT;
+
+static void iirResponseInit(void)
+{
+	pthread_mutex_init(&shelfCache.lock, 0);
+	pthread_mutex_init(&bankCache.lock, 0);
+}
+static void iirPreviewFree(iirPreviewCache *c)
+{
+	free(c->freq);
+	free(c->cosW);
+	free(c->sinW);
+	free(c->cos2W);
+	free(c->sin2W);
+	free(c->accRe);
+	free(c->accIm);
+	c->freq = c->cosW = c->sinW = c->cos2W = c->sin2W = c->accRe = c->accIm = 0;
+	for (int i = 0; i < IIRRESPONSE_MAX_SECTIONS; i++)
+	{
+		free(c->term[i].re);
+		free(c->term[i].im);
+		c->term[i].re = c->term[i].im = 0;
+		c->term[i].valid = 0;
+	}
+	c->nPts = c->padded = c->cap = 0;
+}
+// Adopts the display grid, all terms are invalidated when it changed. Returns 0 on success
+static int iirPreviewSetGrid(iirPreviewCache *c, double fs, const double *dispFreq, int nPts)
+{
+	int i;
+	if (c->freq && c->fs == fs && c->nPts == nPts && !memcmp(c->freq, dispFreq, nPts * sizeof(double)))
+		return 0;
+	int padded = (nPts + IIR_LANES - 1) / IIR_LANES * IIR_LANES;
+	if (padded > c->cap)
+	{
+		iirPreviewFree(c);
+		size_t bytes = padded * sizeof(double);
+		c->freq = (double*)malloc(bytes);
+		c->cosW = (double*)malloc(bytes);
+		c->sinW = (double*)malloc(bytes);
+		c->cos2W = (double*)malloc(bytes);
+		c->sin2W = (double*)malloc(bytes);
+		c->accRe = (double*)malloc(bytes);
+		c->accIm = (double*)malloc(bytes);
+		int failed = !c->freq || !c->cosW || !c->sinW || !c->cos2W || !c->sin2W || !c->accRe || !c->accIm;
+		for (i = 0; i < IIRRESPONSE_MAX_SECTIONS; i++)
+		{
+			c->term[i].re = (double*)malloc(bytes);
+			c->term[i].im = (double*)malloc(bytes);
+			failed |= !c->term[i].re || !c->term[i].im;
+		}
+		if (failed)
+		{
+			iirPreviewFree(c);
+			return -1;
+		}
+		c->cap = padded;
+	}
+	memcpy(c->freq, dispFreq, nPts * sizeof(double));
+	for (i = nPts; i < padded; i++)
+		c->freq[i] = dispFreq[nPts - 1];
+	for (i = 0; i < padded; i++)
+	{
+		double omega = (2.0 * M_PI * c->freq[i]) / fs;
+		c->cosW[i] = cos(omega);
+		c->sinW[i] = sin(omega);
+		c->cos2W[i] = cos(omega + omega);
+		c->sin2W[i] = sin(omega + omega);
+	}
+	c->fs = fs;
+	c->nPts = nPts;
+	c->padded = padded;
+	for (i = 0; i < IIRRESPONSE_MAX_SECTIONS; i++)
+		c->term[i].valid = 0;
+	return 0;
+}
+// Returns 1 if the term has to be recomputed, and records its new parameters
+static int iirTermStale(iirTerm *t, const double param[5])
+{
+	if (t->valid && !memcmp(t->param, param, sizeof(t->param)))
+		return 0;
+	memcpy(t->param, param, sizeof(t->param));
+	t->valid = 1;
+	return 1;
+}
+// H(e^jw) = (b0 + b1 e^-jw + b2 e^-2jw) / (1 + a1 e^-jw + a2 e^-2jw), zero where the denominator vanishes
+static void iirSectionResponse(const iirPreviewCache *c, const double coeff[5], double *re, double *im)
+{
+	const iirVec b0 = iirSplat(coeff[0]), b1 = iirSplat(coeff[1]), b2 = iirSplat(coeff[2]);
+	const iirVec a1 = iirSplat(coeff[3]), a2 = iirSplat(coeff[4]);
+	const iirVec one = iirSplat(1.0), floorMagSq = iirSplat(1.0e-24);
+	for (int i = 0; i < c->padded; i += IIR_LANES)
+	{
+		iirVec cw = iirLoad(c->cosW + i), sw = iirLoad(c->sinW + i);
+		iirVec c2w = iirLoad(c->cos2W + i), s2w = iirLoad(c->sin2W + i);
+		iirVec numRe = b0 + b1 * cw + b2 * c2w;
+		iirVec numIm = -(b1 * sw + b2 * s2w);
+		iirVec denRe = one + a1 * cw + a2 * c2w;
+		iirVec denIm = -(a1 * sw + a2 * s2w);
+		iirVec denMagSq = denRe * denRe + denIm * denIm;
+		iirMask usable = denMagSq >= floorMagSq;
+		iirVec inv = one / (denMagSq + (iirVec)((iirMask)one & ~usable));
+		iirVec hRe = (numRe * denRe + numIm * denIm) * inv;
+		iirVec hIm = (numIm * denRe - numRe * denIm) * inv;
+		iirStore(re + i, (iirVec)((iirMask)hRe & usable));
+		iirStore(im + i, (iirVec)((iirMask)hIm & usable));
+	}
+}
+int iirShelfCascadeResponse(double fs, unsigned int order, int terms, const double *designFreq, const double *dB, const double *overallDb, const double *dispFreq, int nPts, double *cplxRe, double *cplxIm)
+{
+	int i, j;
+	if (nPts <= 0 || terms < 0 || terms > IIRRESPONSE_MAX_SECTIONS)
+		return -1;
+	pthread_once(&cacheOnce, iirResponseInit);
+	iirPreviewCache *c = &shelfCache;
+	pthread_mutex_lock(&c->lock);
+	if (iirPreviewSetGrid(c, fs, dispFreq, nPts))
+	{
+		pthread_mutex_unlock(&c->lock);
+		return -1;
+	}
+	for (j = 0; j < terms; j++)
+	{
+		iirTerm *t = &c->term[j];
+		const double param[5] = { designFreq[j], dB[j], overallDb[j], (double)order, 0.0 };
+		if (!iirTermStale(t, param))
+			continue;
+		for (i = 0; i < c->padded; i++)
+		{
+			t->re[i] = 1.0;
+			t->im[i] = 0.0;
+		}
+		HSHOResponse(fs, designFreq[j], order, dB[j], overallDb[j], c->padded, c->freq, t->re, t->im);
+	}
+	for (i = 0; i < c->padded; i += IIR_LANES)
+	{
+		iirVec accRe = iirSplat(1.0), accIm = iirSplat(0.0);
+		for (j = 0; j < terms; j++)
+		{
+			iirVec tRe = iirLoad(c->term[j].re + i), tIm = iirLoad(c->term[j].im + i);
+			iirVec re = accRe * tRe - accIm * tIm;
+			accIm = accRe * tIm + accIm * tRe;
+			accRe = re;
+		}
+		iirStore(c->accRe + i, accRe);
+		iirStore(c->accIm + i, accIm);
+	}
+	memcpy(cplxRe, c->accRe, nPts * sizeof(double));
+	memcpy(cplxIm, c->accIm, nPts * sizeof(double));
+	pthread_mutex_unlock(&c->lock);
+	return 0;
+}
+int iirParallelBankResponse(double fs, int sections, const double *coeff, const double *gain, const double *dispFreq, int nPts, float *responseDb)
+{
+	int i, j;
+	if (nPts <= 0 || sections < 0 || sections > IIRRESPONSE_MAX_SECTIONS)
+		return -1;
+	pthread_once(&cacheOnce, iirResponseInit);
+	iirPreviewCache *c = &bankCache;
+	pthread_mutex_lock(&c->lock);
+	if (iirPreviewSetGrid(c, fs, dispFreq, nPts))
+	{
+		pthread_mutex_unlock(&c->lock);
+		return -1;
+	}
+	// The unit responses do not depend on the band gains, a gain change only redoes the weighted sum
+	for (j = 0; j < sections; j++)
+		if (iirTermStale(&c->term[j], coeff + j * 5))
+			iirSectionResponse(c, coeff + j * 5, c->term[j].re, c->term[j].im);
+	for (i = 0; i < c->padded; i += IIR_LANES)
+	{
+		iirVec accRe = iirSplat(0.0), accIm = iirSplat(0.0);
+		for (j = 0; j < sections; j++)
+		{
+			iirVec g = iirSplat(gain[j]);
+			accRe += iirLoad(c->term[j].re + i) * g;
+			accIm += iirLoad(c->term[j].im + i) * g;
+		}
+		iirStore(c->accRe + i, accRe * accRe + accIm * accIm); // Squared magnitude
+	}
+	// Same 1e-20 magnitude floor, applied to the squared magnitude
+	for (i = 0; i < nPts; i++)
+		responseDb[i] = (float)(10.0 * log10(c->accRe[i] < 1.0e-40 ? 1.0e-40 : c->accRe[i]));
+	pthread_mutex_unlock(&c->lock);
+	return 0;
+}
+void iirResponseCacheClear(void)
+{
+	pthread_once(&cacheOnce, iirResponseInit);
+	pthread_mutex_lock(&shelfCache.lock);
+	iirPreviewFree(&shelfCache);
+	pthread_mutex_unlock(&shelfCache.lock);
+	pthread_mutex_lock(&bankCache.lock);
+	iirPreviewFree(&bankCache);
+	pthread_mutex_unlock(&bankCache.lock);
+}
@@ -0,0 +1,17 @@
+#ifndef __IIRRESPONSE_H__
+#define __IIRRESPONSE_H__
+// Frequency response of IIR EQ previews evaluated at the display frequencies.
+// Every band's complex response is kept per display grid and only recomputed when that band's
+// parameters change, so dragging one band costs one band term plus the combining pass.
+// The combining and second-order section kernels process two display points per SIMD vector.
+// Both entry points serialize on their own cache and are safe to call from any thread.
+#define IIRRESPONSE_MAX_SECTIONS 16
+// Product of high order shelf terms (HSHOResponse), cplx receives nPts complex values.
+// Term i is designed at designFreq[i] with gain dB[i] and overall gain overallDb[i]. Returns 0 on success
+int iirShelfCascadeResponse(double fs, unsigned int order, int terms, const double *designFreq, const double *dB, const double *overallDb, const double *dispFreq, int nPts, double *cplxRe, double *cplxIm);
+// Weighted sum of second-order sections, coeff holds b0, b1, b2, a1, a2 per section (a0 = 1).
+// Points where a section's denominator is numerically zero skip that section. responseDb receives 20*log10|H|
+int iirParallelBankResponse(double fs, int sections, const double *coeff, const double *gain, const double *dispFreq, int nPts, float *responseDb);
+// Drops all cached band terms, the next call recomputes everything
+void iirResponseCacheClear(void);
+#endif /* __IIRRESPONSE_H__ */
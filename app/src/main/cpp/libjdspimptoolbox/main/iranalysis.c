@@ -0,0 +1,159 @@
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "iranalysis.h"
+
+int analyseImpulseResponse(irAnalysis *ir, float **signal, int channels, int frames)
+{
+	memset(ir, 0, sizeof(irAnalysis));
+	if (channels < 1 || channels > IRANALYSIS_MAX_CHANNELS || frames < 1)
+		return -1;
+	ir->channels = channels;
+	ir->frames = frames;
+	ir->nBlocks = (frames + IRANALYSIS_BLOCK_LEN - 1) / IRANALYSIS_BLOCK_LEN;
+	ir->blockPeak = (float*)malloc((size_t)channels * ir->nBlocks * sizeof(float));
+	if (!ir->blockPeak)
+		return -1;
+	int peakBlock = 0;
+	ir->peak = -1.0f;
+	for (int i = 0; i < channels; i++)
+	{
+		const float *x = signal[i];
+		float *env = ir->blockPeak + (size_t)i * ir->nBlocks;
+		double energy = 0.0;
+		for (int b = 0; b < ir->nBlocks; b++)
+		{
+			const float *blk = x + b * IRANALYSIS_BLOCK_LEN;
+			int len = frames - b * IRANALYSIS_BLOCK_LEN;
+			if (len > IRANALYSIS_BLOCK_LEN)
+				len = IRANALYSIS_BLOCK_LEN;
+			// Branch free so the compiler can keep the whole block in vector registers
+			float m = 0.0f, e = 0.0f;
+			for (int k = 0; k < len; k++)
+			{
+				float a = fabsf(blk[k]);
+				m = a > m ? a : m;
+				e += blk[k] * blk[k];
+			}
+			env[b] = m;
+			energy += e;
+			if (m > ir->peak)
+			{
+				ir->peak = m;
+				ir->peakChannel = i;
+				peakBlock = b;
+			}
+		}
+		ir->energy[i] = energy;
+	}
+	// First sample of the peak block that reaches the maximum. A block of NaNs leaves its maximum at 0 and may
+	// match nothing, the scan therefore stops at the block end and falls back to the block start.
+	const float *blk = signal[ir->peakChannel] + peakBlock * IRANALYSIS_BLOCK_LEN;
+	int len = frames - peakBlock * IRANALYSIS_BLOCK_LEN;
+	if (len > IRANALYSIS_BLOCK_LEN)
+		len = IRANALYSIS_BLOCK_LEN;
+	int k = 0;
+	while (k < len && fabsf(blk[k]) != ir->peak)
+		k++;
+	if (k == len)
+		k = 0;
+	ir->peakIndex = peakBlock * IRANALYSIS_BLOCK_LEN + k;
+	return 0;
+}
+void freeIrAnalysis(irAnalysis *ir)
+{
+	free(ir->blockPeak);
+	ir->blockPeak = 0;
+}
+static float irAnalysisInvPeak(const irAnalysis *ir)
+{
+	return 1.0f / ((ir->peak < FLT_EPSILON) ? (ir->peak + FLT_EPSILON) : ir->peak);
+}
+// fl(|x| * inv) is monotonic in |x|, so a block holds a crossing exactly when its maximum does
+int irAnalysisOnset(const irAnalysis *ir, float **signal, int ch, float linGain)
+{
+	const float inv = irAnalysisInvPeak(ir);
+	const float *env = ir->blockPeak + (size_t)ch * ir->nBlocks;
+	for (int b = 0; b < ir->nBlocks; b++)
+	{
+		if (env[b] * inv > linGain)
+		{
+			int j = b * IRANALYSIS_BLOCK_LEN;
+			while (!(fabsf(signal[ch][j]) * inv > linGain))
+				j++;
+			return j;
+		}
+	}
+	return -1;
+}
+int irAnalysisTail(const irAnalysis *ir, float **signal, int ch, float linGain)
+{
+	const float inv = irAnalysisInvPeak(ir);
+	const float *env = ir->blockPeak + (size_t)ch * ir->nBlocks;
+	for (int b = ir->nBlocks - 1; b >= 0; b--)
+	{
+		if (env[b] * inv > linGain)
+		{
+			int j = b * IRANALYSIS_BLOCK_LEN + IRANALYSIS_BLOCK_LEN - 1;
+			if (j > ir->frames - 1)
+				j = ir->frames - 1;
+			while (!(fabsf(signal[ch][j]) * inv > linGain))
+				j--;
+			return j;
+		}
+	}
+	return -1;
+}
+void irAnalysisTrimRange(const irAnalysis *ir, float **signal, float startCutdB, float endCutdB, int range[2])
+{
+	float linGain1 = powf(10.0f, startCutdB / 20.0f);
+	float linGain2 = powf(10.0f, endCutdB / 20.0f);
+	int first = ir->frames - 1;
+	int last = 0;
+	for (int i = 0; i < ir->channels; i++)
+	{
+		// A channel without onset counts as starting at 0, a channel without tail does not extend the range
+		int onset = irAnalysisOnset(ir, signal, i, linGain1);
+		if (onset < 0)
+			onset = 0;
+		int tail = irAnalysisTail(ir, signal, i, linGain2);
+		first = first < onset ? first : onset;
+		last = last > tail ? last : tail;
+	}
+	range[0] = first != (ir->frames - 1) ? first : 0;
+	range[1] = last + 1;
+}
+int32_t irJoinInterleavedCrc(float **signal, unsigned int channels, float *out, unsigned int frames)
+{
+	// Each word only goes through 8 rounds of the reflected CRC-32 step. That step is linear, so
+	// the 8 rounds collapse into an arithmetic shift by 8 and a lookup on the low byte.
+	int32_t tbl[256];
+	for (int32_t b = 0; b < 256; b++)
+	{
+		int32_t c = b;
+		for (int j = 7; j >= 0; j--)
+		{
+			int32_t mask = -(c & 1);
+			c = (c >> 1) ^ (0xEDB88320 & mask);
+		}
+		tbl[b] = c;
+	}
+	union
+	{
+		int32_t raw;
+		float f;
+	} fltInt;
+	int32_t crc = 0xFFFFFFFF;
+	for (unsigned int i = 0; i < frames; i++)
+	{
+		for (unsigned int c = 0; c < channels; c++)
+		{
+			fltInt.f = signal[c][i];
+			*out++ = fltInt.f;
+			crc ^= fltInt.raw;
+			crc = (crc >> 8) ^ tbl[crc & 0xFF];
+		}
+	}
+	return ~crc;
+}
@@ -0,0 +1,30 @@
+#ifndef __IRANALYSIS_H__
+#define __IRANALYSIS_H__
+#include <stdint.h>
+// Impulse response analysis over planar channel buffers.
+// analyseImpulseResponse() reads every sample exactly once and keeps a per block peak envelope,
+// onset/tail searches afterwards only revisit the single block that contains the crossing.
+#define IRANALYSIS_BLOCK_LEN 64
+#define IRANALYSIS_MAX_CHANNELS 8
+typedef struct
+{
+	int channels;
+	int frames;
+	int nBlocks;
+	float peak; // Absolute peak across all channels
+	int peakChannel, peakIndex; // First occurrence of the peak
+	double energy[IRANALYSIS_MAX_CHANNELS]; // Sum of squares per channel
+	float *blockPeak; // channels * nBlocks absolute block maxima
+} irAnalysis;
+// Returns 0 on success
+int analyseImpulseResponse(irAnalysis *ir, float **signal, int channels, int frames);
+void freeIrAnalysis(irAnalysis *ir);
+// First sample of channel ch whose peak normalized magnitude exceeds linGain, -1 if none
+int irAnalysisOnset(const irAnalysis *ir, float **signal, int ch, float linGain);
+// Last sample of channel ch whose peak normalized magnitude exceeds linGain, -1 if none
+int irAnalysisTail(const irAnalysis *ir, float **signal, int ch, float linGain);
+// Trim range for the given start/end cutoffs in dB relative to the peak, [range[0], range[1])
+void irAnalysisTrimRange(const irAnalysis *ir, float **signal, float startCutdB, float endCutdB, int range[2]);
+// Interleaves the planar buffers into out and returns the checksum reported to the app
+int32_t irJoinInterleavedCrc(float **signal, unsigned int channels, float *out, unsigned int frames);
+#endif /* __IRANALYSIS_H__ */
@@ -0,0 +1,370 @@
+#include <stdlib.h>
+#include <math.h>
+#include "minphase.h"
+#include "threadpool.h"
+
+// Transforms with at least this many complex points are split across the pool,
+// shorter ones are cheaper to run as one task per channel
+#define MINPHASE_PARALLEL_MIN_LEN 16384
+#define MINPHASE_MIN_BLOCK_LEN 1024
+
+typedef struct
+{
+	float *re, *im; // Complex FFT work buffer, halfLen points
+	float *specRe, *specIm; // Half spectrum, halfLen + 1 bins
+} minPhaseLane;
+
+int initMinPhaseEngine(minPhaseEngine *mp, unsigned int xLen, float threshdB)
+{
+	unsigned int i, h, bits = 0;
+	mp->xLen = xLen;
+	mp->fftLen = 4;
+	while (mp->fftLen < xLen)
+		mp->fftLen <<= 1;
+	mp->halfLen = mp->fftLen >> 1;
+	while ((1u << bits) < mp->halfLen)
+		bits++;
+	mp->bitRev = (unsigned int*)malloc(mp->halfLen * sizeof(unsigned int));
+	mp->twRe = (float*)malloc(mp->halfLen * sizeof(float));
+	mp->twIm = (float*)malloc(mp->halfLen * sizeof(float));
+	mp->rotRe = (float*)malloc((mp->halfLen + 1) * sizeof(float));
+	mp->rotIm = (float*)malloc((mp->halfLen + 1) * sizeof(float));
+	if (!mp->bitRev || !mp->twRe || !mp->twIm || !mp->rotRe || !mp->rotIm)
+	{
+		freeMinPhaseEngine(mp);
+		return -1;
+	}
+	for (i = 0; i < mp->halfLen; i++)
+	{
+		unsigned int x = i, y = 0;
+		for (unsigned int b = 0; b < bits; b++)
+		{
+			y = (y << 1) | (x & 1);
+			x >>= 1;
+		}
+		mp->bitRev[i] = y;
+	}
+	for (h = 1; h < mp->halfLen; h <<= 1)
+	{
+		for (i = 0; i < h; i++)
+		{
+			double phi = -3.141592653589793238462643383279502884 * i / h;
+			mp->twRe[h - 1 + i] = (float)cos(phi);
+			mp->twIm[h - 1 + i] = (float)sin(phi);
+		}
+	}
+	for (i = 0; i <= mp->halfLen; i++)
+	{
+		double phi = -6.283185307179586476925286766559 * i / mp->fftLen;
+		mp->rotRe[i] = (float)cos(phi);
+		mp->rotIm[i] = (float)sin(phi);
+	}
+	mp->threshold = powf(10.0f, threshdB / 20.0f);
+	mp->logThreshold = logf(mp->threshold);
+	mp->normalizeGain = 1.0f / mp->fftLen;
+	return 0;
+}
+void freeMinPhaseEngine(minPhaseEngine *mp)
+{
+	free(mp->bitRev);
+	free(mp->twRe);
+	free(mp->twIm);
+	free(mp->rotRe);
+	free(mp->rotIm);
+	mp->bitRev = 0;
+	mp->twRe = mp->twIm = mp->rotRe = mp->rotIm = 0;
+}
+
+// Every pass below works on an index range so that it can either run in one go or be split into tasks.
+// Input/output passes also do the bit reversal, the butterflies then run on naturally ordered data.
+static void mpPackInput(const minPhaseEngine *mp, minPhaseLane *ln, const float *x, unsigned int begin, unsigned int end)
+{
+	for (unsigned int n = begin; n < end; n++)
+	{
+		unsigned int r = mp->bitRev[n];
+		ln->re[r] = 2 * n < mp->xLen ? x[2 * n] : 0.0f;
+		ln->im[r] = 2 * n + 1 < mp->xLen ? x[2 * n + 1] : 0.0f;
+	}
+}
+// Radix-2 stages with half size 1..lastH, confined to the block [begin, end)
+static void mpLocalStages(const minPhaseEngine *mp, minPhaseLane *ln, unsigned int begin, unsigned int end, unsigned int lastH)
+{
+	float *re = ln->re, *im = ln->im;
+	for (unsigned int h = 1; h <= lastH; h <<= 1)
+	{
+		const float *wr = mp->twRe + h - 1, *wi = mp->twIm + h - 1;
+		for (unsigned int g = begin; g < end; g += 2 * h)
+		{
+			float *r0 = re + g, *i0 = im + g, *r1 = re + g + h, *i1 = im + g + h;
+			for (unsigned int j = 0; j < h; j++)
+			{
+				float tr = r1[j] * wr[j] - i1[j] * wi[j];
+				float ti = r1[j] * wi[j] + i1[j] * wr[j];
+				r1[j] = r0[j] - tr;
+				i1[j] = i0[j] - ti;
+				r0[j] += tr;
+				i0[j] += ti;
+			}
+		}
+	}
+}
+// One stage with half size h over the butterflies [begin, end) of the flattened butterfly index
+static void mpGlobalStage(const minPhaseEngine *mp, minPhaseLane *ln, unsigned int h, unsigned int begin, unsigned int end)
+{
+	float *re = ln->re, *im = ln->im;
+	const float *wr = mp->twRe + h - 1, *wi = mp->twIm + h - 1;
+	while (begin < end)
+	{
+		unsigned int j = begin & (h - 1);
+		unsigned int cnt = h - j;
+		if (cnt > end - begin)
+			cnt = end - begin;
+		unsigned int base = (begin - j) * 2 + j;
+		float *r0 = re + base, *i0 = im + base, *r1 = re + base + h, *i1 = im + base + h;
+		const float *cr = wr + j, *ci = wi + j;
+		for (unsigned int k = 0; k < cnt; k++)
+		{
+			float tr = r1[k] * cr[k] - i1[k] * ci[k];
+			float ti = r1[k] * ci[k] + i1[k] * cr[k];
+			r1[k] = r0[k] - tr;
+			i1[k] = i0[k] - ti;
+			r0[k] += tr;
+			i0[k] += ti;
+		}
+		begin += cnt;
+	}
+}
+// Half length complex spectrum -> real signal spectrum bins [begin, end), end <= halfLen + 1
+// expMode 0 stores the thresholded log magnitude, 1 stores the complex exponential
+static void mpSplitSpectrum(const minPhaseEngine *mp, minPhaseLane *ln, int expMode, unsigned int begin, unsigned int end)
+{
+	const unsigned int M = mp->halfLen;
+	for (unsigned int k = begin; k < end; k++)
+	{
+		unsigned int a = k == M ? 0 : k, b = k ? M - k : 0;
+		float zr = ln->re[a], zi = ln->im[a];
+		float cr = ln->re[b], ci = -ln->im[b];
+		float er = (zr + cr) * 0.5f, ei = (zi + ci) * 0.5f;
+		float odr = (zi - ci) * 0.5f, odi = (cr - zr) * 0.5f;
+		float xr = er + mp->rotRe[k] * odr - mp->rotIm[k] * odi;
+		float xi = ei + mp->rotRe[k] * odi + mp->rotIm[k] * odr;
+		if (!expMode)
+		{
+			float magnitude = hypotf(xr, xi);
+			ln->specRe[k] = magnitude < mp->threshold ? mp->logThreshold : logf(magnitude);
+			ln->specIm[k] = 0.0f;
+		}
+		else
+		{
+			float eR = expf(xr);
+			ln->specRe[k] = eR * cosf(xi);
+			ln->specIm[k] = eR * sinf(xi);
+		}
+	}
+}
+// Half spectrum -> bit reversed, conjugated complex buffer, a forward FFT then yields the
+// conjugate of the unnormalized inverse real FFT packed as even/odd pairs
+static void mpMergeSpectrum(const minPhaseEngine *mp, minPhaseLane *ln, unsigned int begin, unsigned int end)
+{
+	const unsigned int M = mp->halfLen;
+	for (unsigned int k = begin; k < end; k++)
+	{
+		float ar = ln->specRe[k], ai = ln->specIm[k];
+		float br = ln->specRe[M - k], bi = -ln->specIm[M - k];
+		float er = ar + br, ei = ai + bi;
+		float dr = ar - br, di = ai - bi;
+		float odr = dr * mp->rotRe[k] + di * mp->rotIm[k];
+		float odi = di * mp->rotRe[k] - dr * mp->rotIm[k];
+		unsigned int r = mp->bitRev[k];
+		ln->re[r] = er - odi;
+		ln->im[r] = -(ei + odr);
+	}
+}
+static inline float mpFold(const minPhaseEngine *mp, unsigned int j, float v)
+{
+	if (!j || j == mp->halfLen)
+		return v * mp->normalizeGain;
+	return j < mp->halfLen ? 2.0f * v * mp->normalizeGain : 0.0f;
+}
+// Cepstrum -> causal folded cepstrum, repacked in place for the next forward real FFT
+static void mpFoldRepack(const minPhaseEngine *mp, minPhaseLane *ln, unsigned int begin, unsigned int end)
+{
+	for (unsigned int n = begin; n < end; n++)
+	{
+		unsigned int r = mp->bitRev[n];
+		if (r < n)
+			continue;
+		float nr = mpFold(mp, 2 * n, ln->re[n]), ni = mpFold(mp, 2 * n + 1, -ln->im[n]);
+		float rr = mpFold(mp, 2 * r, ln->re[r]), ri = mpFold(mp, 2 * r + 1, -ln->im[r]);
+		ln->re[r] = nr;
+		ln->im[r] = ni;
+		ln->re[n] = rr;
+		ln->im[n] = ri;
+	}
+}
+static void mpStoreOutput(const minPhaseEngine *mp, minPhaseLane *ln, float *y, unsigned int begin, unsigned int end)
+{
+	for (unsigned int n = begin; n < end; n++)
+	{
+		if (2 * n < mp->xLen)
+			y[2 * n] = ln->re[n] * mp->normalizeGain;
+		if (2 * n + 1 < mp->xLen)
+			y[2 * n + 1] = -ln->im[n] * mp->normalizeGain;
+	}
+}
+static void mpChannelSerial(const minPhaseEngine *mp, minPhaseLane *ln, const float *x, float *y)
+{
+	const unsigned int M = mp->halfLen;
+	mpPackInput(mp, ln, x, 0, M);
+	mpLocalStages(mp, ln, 0, M, M >> 1);
+	mpSplitSpectrum(mp, ln, 0, 0, M + 1);
+	mpMergeSpectrum(mp, ln, 0, M);
+	mpLocalStages(mp, ln, 0, M, M >> 1);
+	mpFoldRepack(mp, ln, 0, M);
+	mpLocalStages(mp, ln, 0, M, M >> 1);
+	mpSplitSpectrum(mp, ln, 1, 0, M + 1);
+	mpMergeSpectrum(mp, ln, 0, M);
+	mpLocalStages(mp, ln, 0, M, M >> 1);
+	mpStoreOutput(mp, ln, y, 0, M);
+}
+
+typedef struct
+{
+	const minPhaseEngine *mp;
+	minPhaseLane *lanes;
+	float **x, **y;
+} mpChannelJob;
+static void mpChannelTask(void *arg, int taskIdx, int threadIdx)
+{
+	mpChannelJob *job = (mpChannelJob*)arg;
+	mpChannelSerial(job->mp, &job->lanes[taskIdx], job->x[taskIdx], job->y[taskIdx]);
+}
+
+enum
+{
+	MP_PASS_PACK,
+	MP_PASS_LOCAL_STAGES,
+	MP_PASS_GLOBAL_STAGE,
+	MP_PASS_SPLIT_LOG,
+	MP_PASS_SPLIT_EXP,
+	MP_PASS_MERGE,
+	MP_PASS_FOLD,
+	MP_PASS_STORE
+};
+typedef struct
+{
+	const minPhaseEngine *mp;
+	minPhaseLane *ln;
+	const float *x;
+	float *y;
+	int pass;
+	unsigned int items, tasks, stageH, blockLen;
+} mpPassJob;
+static void mpPassTask(void *arg, int taskIdx, int threadIdx)
+{
+	mpPassJob *job = (mpPassJob*)arg;
+	unsigned int begin = (unsigned int)((unsigned long long)job->items * taskIdx / job->tasks);
+	unsigned int end = (unsigned int)((unsigned long long)job->items * (taskIdx + 1) / job->tasks);
+	switch (job->pass)
+	{
+	case MP_PASS_PACK:
+		mpPackInput(job->mp, job->ln, job->x, begin, end);
+		break;
+	case MP_PASS_LOCAL_STAGES:
+		mpLocalStages(job->mp, job->ln, taskIdx * job->blockLen, (taskIdx + 1) * job->blockLen, job->blockLen >> 1);
+		break;
+	case MP_PASS_GLOBAL_STAGE:
+		mpGlobalStage(job->mp, job->ln, job->stageH, begin, end);
+		break;
+	case MP_PASS_SPLIT_LOG:
+		mpSplitSpectrum(job->mp, job->ln, 0, begin, end);
+		break;
+	case MP_PASS_SPLIT_EXP:
+		mpSplitSpectrum(job->mp, job->ln, 1, begin, end);
+		break;
+	case MP_PASS_MERGE:
+		mpMergeSpectrum(job->mp, job->ln, begin, end);
+		break;
+	case MP_PASS_FOLD:
+		mpFoldRepack(job->mp, job->ln, begin, end);
+		break;
+	case MP_PASS_STORE:
+		mpStoreOutput(job->mp, job->ln, job->y, begin, end);
+		break;
+	}
+}
+static void mpRunPass(mpPassJob *job, int pass, unsigned int items, unsigned int tasks)
+{
+	job->pass = pass;
+	job->items = items;
+	job->tasks = tasks;
+	threadPoolParallelFor(mpPassTask, job, (int)tasks);
+}
+static void mpParallelFFT(mpPassJob *job, unsigned int tasks)
+{
+	const unsigned int M = job->mp->halfLen;
+	// Early stages stay inside independent blocks, only the last log2(blocks) stages cross them
+	mpRunPass(job, MP_PASS_LOCAL_STAGES, M, M / job->blockLen);
+	for (job->stageH = job->blockLen; job->stageH < M; job->stageH <<= 1)
+		mpRunPass(job, MP_PASS_GLOBAL_STAGE, M >> 1, tasks);
+}
+static void mpChannelParallel(const minPhaseEngine *mp, minPhaseLane *ln, const float *x, float *y, int poolSize)
+{
+	const unsigned int M = mp->halfLen;
+	unsigned int tasks = (unsigned int)poolSize * 2;
+	mpPassJob job;
+	job.mp = mp;
+	job.ln = ln;
+	job.x = x;
+	job.y = y;
+	job.blockLen = M;
+	while (job.blockLen > MINPHASE_MIN_BLOCK_LEN && M / job.blockLen < tasks)
+		job.blockLen >>= 1;
+	mpRunPass(&job, MP_PASS_PACK, M, tasks);
+	mpParallelFFT(&job, tasks);
+	mpRunPass(&job, MP_PASS_SPLIT_LOG, M + 1, tasks);
+	mpRunPass(&job, MP_PASS_MERGE, M, tasks);
+	mpParallelFFT(&job, tasks);
+	mpRunPass(&job, MP_PASS_FOLD, M, tasks);
+	mpParallelFFT(&job, tasks);
+	mpRunPass(&job, MP_PASS_SPLIT_EXP, M + 1, tasks);
+	mpRunPass(&job, MP_PASS_MERGE, M, tasks);
+	mpParallelFFT(&job, tasks);
+	mpRunPass(&job, MP_PASS_STORE, M, tasks);
+}
+int minPhaseTransform(minPhaseEngine *mp, float **x, float **y, int channels)
+{
+	const unsigned int M = mp->halfLen;
+	const size_t laneFloats = (size_t)M * 4 + 2;
+	int poolSize = threadPoolSize();
+	int parallel = poolSize > 1 && M >= MINPHASE_PARALLEL_MIN_LEN;
+	int nLanes = parallel ? 1 : channels;
+	float *scratch = (float*)malloc(laneFloats * nLanes * sizeof(float));
+	minPhaseLane *lanes = (minPhaseLane*)malloc(nLanes * sizeof(minPhaseLane));
+	if (!scratch || !lanes)
+	{
+		free(scratch);
+		free(lanes);
+		return -1;
+	}
+	for (int i = 0; i < nLanes; i++)
+	{
+		lanes[i].re = scratch + laneFloats * i;
+		lanes[i].im = lanes[i].re + M;
+		lanes[i].specRe = lanes[i].im + M;
+		lanes[i].specIm = lanes[i].specRe + M + 1;
+	}
+	if (parallel)
+	{
+		for (int i = 0; i < channels; i++)
+			mpChannelParallel(mp, lanes, x[i], y[i], poolSize);
+	}
+	else
+	{
+		mpChannelJob job = { mp, lanes, x, y };
+		threadPoolParallelFor(mpChannelTask, &job, channels);
+	}
+	free(lanes);
+	free(scratch);
+	return 0;
+}
@@ -0,0 +1,22 @@
+#ifndef __MINPHASE_H__
+#define __MINPHASE_H__
+// Homomorphic (real cepstrum) minimum phase conversion.
+// All four transforms are real FFTs computed through a half length complex FFT, long transforms
+// are split across the shared thread pool, short ones run one channel per thread.
+typedef struct
+{
+	unsigned int xLen;
+	unsigned int fftLen;
+	unsigned int halfLen;
+	unsigned int *bitRev; // halfLen entries
+	float *twRe, *twIm; // Per stage twiddles of the complex FFT, stage with half size h starts at h - 1
+	float *rotRe, *rotIm; // exp(-2*pi*i*k/fftLen), k = 0..halfLen, real FFT split/merge
+	float threshold, logThreshold, normalizeGain;
+} minPhaseEngine;
+// Returns 0 on success
+int initMinPhaseEngine(minPhaseEngine *mp, unsigned int xLen, float threshdB);
+void freeMinPhaseEngine(minPhaseEngine *mp);
+// Converts xLen samples of every x[ch] into y[ch], x and y may point to the same buffers.
+// Returns 0 on success
+int minPhaseTransform(minPhaseEngine *mp, float **x, float **y, int channels);
+#endif /* __MINPHASE_H__ */
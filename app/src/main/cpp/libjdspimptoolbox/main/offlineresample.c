@@ -0,0 +1,268 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "offlineresample.h"
+#include "audiostream.h"
+#include "threadpool.h"
+#include "cpthread.h"
+#include "../libsamplerate/samplerate.h"
+#include "../dr_wav.h"
+
+typedef struct
+{
+	unsigned int channels;
+	double ratio;
+	SRC_STATE **src;
+	float **in; // Planar decoded chunk
+	float **out; // Planar resampled chunk
+	long *generated;
+	int *failed;
+	size_t outCapacity;
+	long chunkFrames;
+	int endOfInput;
+} resampleChunkJob;
+
+static void resampleChannelTask(void *arg, int ch, int threadIdx)
+{
+	resampleChunkJob *job = (resampleChunkJob*)arg;
+	SRC_DATA data;
+	memset(&data, 0, sizeof(data));
+	data.src_ratio = job->ratio;
+	data.data_in = job->in[ch];
+	data.input_frames = job->chunkFrames;
+	data.end_of_input = job->endOfInput;
+	long generated = 0;
+	for (;;)
+	{
+		data.data_out = job->out[ch] + generated;
+		data.output_frames = (long)job->outCapacity - generated;
+		if (src_process(job->src[ch], &data))
+		{
+			job->failed[ch] = 1;
+			break;
+		}
+		generated += data.output_frames_gen;
+		data.data_in += data.input_frames_used;
+		data.input_frames -= data.input_frames_used;
+		if ((size_t)generated >= job->outCapacity)
+			break;
+		if (data.input_frames > 0)
+		{
+			if (!data.input_frames_used && !data.output_frames_gen)
+				break;
+			continue;
+		}
+		// Input exhausted: keep draining the filter tail only at end of stream
+		if (!job->endOfInput || !data.output_frames_gen)
+			break;
+	}
+	job->generated[ch] = generated;
+}
+static void freeResampleChunkJob(resampleChunkJob *job)
+{
+	for (unsigned int c = 0; c < job->channels; c++)
+	{
+		if (job->src && job->src[c])
+			src_delete(job->src[c]);
+		if (job->in)
+			free(job->in[c]);
+		if (job->out)
+			free(job->out[c]);
+	}
+	free(job->src);
+	free(job->in);
+	free(job->out);
+	free(job->generated);
+	free(job->failed);
+}
+static int initResampleChunkJob(resampleChunkJob *job, unsigned int channels, double ratio, int resampleQuality)
+{
+	memset(job, 0, sizeof(resampleChunkJob));
+	job->channels = channels;
+	job->ratio = ratio;
+	// Slack covers the filter tail that is flushed together with the last chunk
+	job->outCapacity = (size_t)ceil(OFFLINERESAMPLE_CHUNK_FRAMES * ratio) + 4096;
+	job->src = (SRC_STATE**)calloc(channels, sizeof(SRC_STATE*));
+	job->in = (float**)calloc(channels, sizeof(float*));
+	job->out = (float**)calloc(channels, sizeof(float*));
+	job->generated = (long*)calloc(channels, sizeof(long));
+	job->failed = (int*)calloc(channels, sizeof(int));
+	if (!job->src || !job->in || !job->out || !job->generated || !job->failed)
+		return -1;
+	for (unsigned int c = 0; c < channels; c++)
+	{
+		int error;
+		job->src[c] = src_new(resampleQuality, 1, &error);
+		job->in[c] = (float*)malloc(OFFLINERESAMPLE_CHUNK_FRAMES * sizeof(float));
+		job->out[c] = (float*)malloc(job->outCapacity * sizeof(float));
+		if (!job->src[c] || !job->in[c] || !job->out[c])
+			return -1;
+	}
+	return 0;
+}
+// parallelChannels spreads the channels of every chunk over the shared pool, otherwise they run inline
+static int resampleFile(const char *inPath, const char *outPath, int targetFs, int resampleQuality, offlineResampleProgress progress, void *userData, int parallelChannels)
+{
+	audioStream st;
+	if (targetFs < 1 || openAudioStream(&st, inPath, targetFs, -1))
+		return OFFLINERESAMPLE_ERROR;
+	const unsigned int channels = st.channels;
+	const int passThrough = st.ratio == 1.0 || (st.inputFrames == 1 && st.outputFrames == 1);
+	resampleChunkJob job;
+	int status = OFFLINERESAMPLE_OK;
+	memset(&job, 0, sizeof(resampleChunkJob));
+	if (!passThrough && initResampleChunkJob(&job, channels, st.ratio, resampleQuality))
+		status = OFFLINERESAMPLE_ERROR;
+	size_t ioFrames = passThrough ? OFFLINERESAMPLE_CHUNK_FRAMES : job.outCapacity;
+	float *decoded = (float*)malloc(OFFLINERESAMPLE_CHUNK_FRAMES * channels * sizeof(float));
+	float *interleaved = (float*)malloc(ioFrames * channels * sizeof(float));
+	drwav wav;
+	int wavOpen = 0;
+	if (status == OFFLINERESAMPLE_OK && decoded && interleaved)
+	{
+		drwav_data_format format;
+		format.container = drwav_container_riff;
+		format.format = DR_WAVE_FORMAT_IEEE_FLOAT;
+		format.channels = channels;
+		format.sampleRate = targetFs;
+		format.bitsPerSample = 32;
+		wavOpen = drwav_init_file_write(&wav, outPath, &format, 0);
+	}
+	if (!wavOpen)
+		status = OFFLINERESAMPLE_ERROR;
+	uint64_t consumed = 0, written = 0;
+	int eof = 0;
+	while (status == OFFLINERESAMPLE_OK && !eof)
+	{
+		uint64_t n = readAudioStreamFrames(&st, OFFLINERESAMPLE_CHUNK_FRAMES, decoded);
+		consumed += n;
+		eof = n < OFFLINERESAMPLE_CHUNK_FRAMES || consumed >= st.inputFrames;
+		const float *block = decoded;
+		uint64_t frames = n;
+		if (!passThrough)
+		{
+			for (unsigned int c = 0; c < channels; c++)
+				for (uint64_t i = 0; i < n; i++)
+					job.in[c][i] = decoded[i * channels + c];
+			job.chunkFrames = (long)n;
+			job.endOfInput = eof;
+			if (parallelChannels)
+				threadPoolParallelFor(resampleChannelTask, &job, (int)channels);
+			else
+				for (unsigned int c = 0; c < channels; c++)
+					resampleChannelTask(&job, (int)c, 0);
+			// All channels run identical converters on equally long input, so the counts agree
+			frames = (uint64_t)job.generated[0];
+			for (unsigned int c = 0; c < channels; c++)
+			{
+				if (job.failed[c])
+					status = OFFLINERESAMPLE_ERROR;
+				if ((uint64_t)job.generated[c] < frames)
+					frames = (uint64_t)job.generated[c];
+			}
+			for (unsigned int c = 0; c < channels; c++)
+				for (uint64_t i = 0; i < frames; i++)
+					interleaved[i * channels + c] = job.out[c][i];
+			block = interleaved;
+		}
+		if (frames > st.outputFrames - written)
+			frames = st.outputFrames - written;
+		if (frames && drwav_write_pcm_frames(&wav, frames, block) != frames)
+			status = OFFLINERESAMPLE_ERROR;
+		written += frames;
+		if (status == OFFLINERESAMPLE_OK && progress && progress(userData, 0, eof ? 1.0 : (double)consumed / st.inputFrames))
+			status = OFFLINERESAMPLE_CANCELLED;
+	}
+	if (status == OFFLINERESAMPLE_OK && written < st.outputFrames)
+	{
+		// Same length as the one shot conversion, the part the filter did not produce is silence
+		memset(interleaved, 0, ioFrames * channels * sizeof(float));
+		while (status == OFFLINERESAMPLE_OK && written < st.outputFrames)
+		{
+			uint64_t frames = st.outputFrames - written;
+			if (frames > ioFrames)
+				frames = ioFrames;
+			if (drwav_write_pcm_frames(&wav, frames, interleaved) != frames)
+				status = OFFLINERESAMPLE_ERROR;
+			written += frames;
+		}
+	}
+	if (wavOpen)
+		drwav_uninit(&wav);
+	if (wavOpen && status != OFFLINERESAMPLE_OK)
+		remove(outPath);
+	free(decoded);
+	free(interleaved);
+	freeResampleChunkJob(&job);
+	closeAudioStream(&st);
+	return status;
+}
+int offlineResampleFile(const char *inPath, const char *outPath, int targetFs, int resampleQuality, offlineResampleProgress progress, void *userData)
+{
+	return resampleFile(inPath, outPath, targetFs, resampleQuality, progress, userData, 1);
+}
+
+typedef struct
+{
+	const char **inPaths, **outPaths;
+	int targetFs, resampleQuality;
+	offlineResampleProgress progress;
+	void *userData;
+	int *results;
+	int count;
+	int next;
+	int cancelled;
+} resampleBatchJob;
+typedef struct
+{
+	resampleBatchJob *batch;
+	int fileIdx;
+} resampleBatchFile;
+static int resampleBatchProgress(void *userData, int unused, double progress)
+{
+	resampleBatchFile *file = (resampleBatchFile*)userData;
+	resampleBatchJob *batch = file->batch;
+	if (batch->progress && batch->progress(batch->userData, file->fileIdx, progress))
+		__atomic_store_n(&batch->cancelled, 1, __ATOMIC_RELAXED);
+	return __atomic_load_n(&batch->cancelled, __ATOMIC_RELAXED);
+}
+static void *resampleBatchThread(void *arg)
+{
+	resampleBatchJob *batch = (resampleBatchJob*)arg;
+	int fileIdx;
+	while ((fileIdx = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED)) < batch->count)
+	{
+		if (__atomic_load_n(&batch->cancelled, __ATOMIC_RELAXED))
+		{
+			batch->results[fileIdx] = OFFLINERESAMPLE_CANCELLED;
+			continue;
+		}
+		resampleBatchFile file = { batch, fileIdx };
+		// Channels run inline, the other batch threads already keep the cores busy with other files
+		batch->results[fileIdx] = resampleFile(batch->inPaths[fileIdx], batch->outPaths[fileIdx], batch->targetFs, batch->resampleQuality, resampleBatchProgress, &file, 0);
+	}
+	return 0;
+}
+int offlineResampleFiles(const char **inPaths, const char **outPaths, int count, int targetFs, int resampleQuality, offlineResampleProgress progress, void *userData, int *results)
+{
+	resampleBatchJob batch = { inPaths, outPaths, targetFs, resampleQuality, progress, userData, results, count, 0, 0 };
+	// A batch runs for minutes, on the shared pool it would hold the job lock and stall IR loading and previews
+	// for that long. It gets threads of its own instead, as many as the pool has, with the caller as the first.
+	pthread_t threads[16];
+	int nThreads = threadPoolSize() - 1;
+	if (nThreads > count - 1)
+		nThreads = count - 1;
+	if (nThreads > (int)(sizeof(threads) / sizeof(threads[0])))
+		nThreads = (int)(sizeof(threads) / sizeof(threads[0]));
+	int started = 0;
+	while (started < nThreads && !pthread_create(&threads[started], 0, resampleBatchThread, &batch))
+		started++;
+	resampleBatchThread(&batch);
+	for (int i = 0; i < started; i++)
+		pthread_join(threads[i], 0);
+	int succeeded = 0;
+	for (int i = 0; i < count; i++)
+		succeeded += results[i] == OFFLINERESAMPLE_OK;
+	return succeeded;
+}
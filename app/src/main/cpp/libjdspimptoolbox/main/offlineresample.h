@@ -0,0 +1,19 @@
+#ifndef __OFFLINERESAMPLE_H__
+#define __OFFLINERESAMPLE_H__
+// Streaming file to file sample rate conversion.
+// Input is decoded in fixed size chunks, every channel runs through its own SRC_STATE on the shared
+// thread pool and the result is appended to a 32 bit float wav, so memory use does not depend on file length.
+#define OFFLINERESAMPLE_OK 0
+#define OFFLINERESAMPLE_CANCELLED 1
+#define OFFLINERESAMPLE_ERROR -1
+#define OFFLINERESAMPLE_CHUNK_FRAMES 16384
+// Called after every chunk with the progress of file fileIdx in [0, 1]. Return nonzero to cancel.
+// Batch conversion calls it from worker threads, it must be thread safe.
+typedef int (*offlineResampleProgress)(void *userData, int fileIdx, double progress);
+// Returns OFFLINERESAMPLE_*; a cancelled or failed conversion removes the partial output file
+int offlineResampleFile(const char *inPath, const char *outPath, int targetFs, int resampleQuality, offlineResampleProgress progress, void *userData);
+// Converts count files concurrently on threads of its own, the caller's included, so the shared pool stays free.
+// results[i] receives the status of file i.
+// Returns the number of files converted successfully
+int offlineResampleFiles(const char **inPaths, const char **outPaths, int count, int targetFs, int resampleQuality, offlineResampleProgress progress, void *userData, int *results);
+#endif /* __OFFLINERESAMPLE_H__ */
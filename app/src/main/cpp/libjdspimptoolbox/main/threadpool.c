@@ -0,0 +1,151 @@
+#include <stdlib.h>
+#include "cpthread.h"
+#include "threadpool.h"
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+#define THREADPOOL_MAX_WORKERS 7
+// Snapshot of one job, taken under pool.lock
+typedef struct
+{
+	unsigned int generation;
+	threadPoolTask task;
+	void *arg;
+	int count;
+} threadPoolJob;
+typedef struct
+{
+	pthread_mutex_t lock;
+	pthread_mutex_t jobLock;
+	pthread_cond_t wake;
+	pthread_cond_t done;
+	pthread_t threads[THREADPOOL_MAX_WORKERS];
+	int nWorkers;
+	unsigned int generation;
+	threadPoolTask task;
+	void *arg;
+	int count;
+	// generation << 32 | next task index. Claims go through a CAS against the own job's generation, so a
+	// worker that lags behind cannot take an index of the job that replaced its own.
+	unsigned long long claim;
+	int pending;
+} threadPool;
+static threadPool pool;
+static pthread_once_t poolOnce = PTHREAD_ONCE_INIT;
+static __thread int insidePoolTask = 0;
+
+static int threadPoolClaim(const threadPoolJob *job)
+{
+	unsigned long long claim = __atomic_load_n(&pool.claim, __ATOMIC_ACQUIRE);
+	for (;;)
+	{
+		if ((unsigned int)(claim >> 32) != job->generation || (int)(unsigned int)claim >= job->count)
+			return -1;
+		if (__atomic_compare_exchange_n(&pool.claim, &claim, claim + 1, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+			return (int)(unsigned int)claim;
+	}
+}
+static void threadPoolRunTasks(const threadPoolJob *job, int threadIdx)
+{
+	int i;
+	insidePoolTask = 1;
+	while ((i = threadPoolClaim(job)) >= 0)
+	{
+		job->task(job->arg, i, threadIdx);
+		if (__atomic_sub_fetch(&pool.pending, 1, __ATOMIC_ACQ_REL) == 0)
+		{
+			pthread_mutex_lock(&pool.lock);
+			pthread_cond_broadcast(&pool.done);
+			pthread_mutex_unlock(&pool.lock);
+		}
+	}
+	insidePoolTask = 0;
+}
+static void *threadPoolWorker(void *args)
+{
+	int threadIdx = (int)(size_t)args;
+	unsigned int seen = 0;
+	threadPoolJob job;
+	for (;;)
+	{
+		pthread_mutex_lock(&pool.lock);
+		while (pool.generation == seen)
+			pthread_cond_wait(&pool.wake, &pool.lock);
+		seen = pool.generation;
+		job.generation = pool.generation;
+		job.task = pool.task;
+		job.arg = pool.arg;
+		job.count = pool.count;
+		pthread_mutex_unlock(&pool.lock);
+		threadPoolRunTasks(&job, threadIdx);
+	}
+	return 0;
+}
+static int threadPoolCpuCount(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return (int)info.dwNumberOfProcessors;
+#else
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n < 1 ? 1 : (int)n;
+#endif
+}
+static void threadPoolInit(void)
+{
+	pthread_mutex_init(&pool.lock, 0);
+	pthread_mutex_init(&pool.jobLock, 0);
+	pthread_cond_init(&pool.wake, 0);
+	pthread_cond_init(&pool.done, 0);
+	// Workers live for the remainder of the process, they only cost a parked thread each while idle
+	int n = threadPoolCpuCount() - 1;
+	if (n > THREADPOOL_MAX_WORKERS)
+		n = THREADPOOL_MAX_WORKERS;
+	pool.nWorkers = 0;
+	for (int i = 0; i < n; i++)
+	{
+		if (pthread_create(&pool.threads[i], 0, threadPoolWorker, (void*)(size_t)(i + 1)))
+			break;
+		pthread_detach(pool.threads[i]);
+		pool.nWorkers++;
+	}
+}
+int threadPoolSize(void)
+{
+	pthread_once(&poolOnce, threadPoolInit);
+	return pool.nWorkers + 1;
+}
+void threadPoolParallelFor(threadPoolTask task, void *arg, int count)
+{
+	if (count <= 0)
+		return;
+	if (count == 1 || insidePoolTask || threadPoolSize() == 1)
+	{
+		for (int i = 0; i < count; i++)
+			task(arg, i, 0);
+		return;
+	}
+	threadPoolJob job;
+	pthread_mutex_lock(&pool.jobLock);
+	pthread_mutex_lock(&pool.lock);
+	pool.generation++;
+	pool.task = task;
+	pool.arg = arg;
+	pool.count = count;
+	job.generation = pool.generation;
+	job.task = task;
+	job.arg = arg;
+	job.count = count;
+	__atomic_store_n(&pool.pending, count, __ATOMIC_RELAXED);
+	__atomic_store_n(&pool.claim, (unsigned long long)job.generation << 32, __ATOMIC_RELEASE);
+	pthread_cond_broadcast(&pool.wake);
+	pthread_mutex_unlock(&pool.lock);
+	threadPoolRunTasks(&job, 0);
+	pthread_mutex_lock(&pool.lock);
+	while (__atomic_load_n(&pool.pending, __ATOMIC_ACQUIRE) > 0)
+		pthread_cond_wait(&pool.done, &pool.lock);
+	pthread_mutex_unlock(&pool.lock);
+	pthread_mutex_unlock(&pool.jobLock);
+}
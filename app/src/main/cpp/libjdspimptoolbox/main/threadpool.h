@@ -0,0 +1,13 @@
+#ifndef __THREADPOOL_H__
+#define __THREADPOOL_H__
+// Process-wide worker pool shared by the toolbox's offline jobs (IR conversion, resampling, previews).
+// Workers are started on first use and then sleep on a condition variable between jobs.
+// taskIdx enumerates the tasks of one job, threadIdx identifies the executing thread
+// (0 is the calling thread, 1..threadPoolSize()-1 are workers) and can index per-thread scratch.
+typedef void (*threadPoolTask)(void *arg, int taskIdx, int threadIdx);
+// Number of threads that may execute tasks of one job, including the caller
+int threadPoolSize(void);
+// Runs task(arg, 0..count-1) and returns once all tasks finished. The caller participates.
+// Calls from inside a pool task, or while another job is running, execute inline/serialized.
+void threadPoolParallelFor(threadPoolTask task, void *arg, int count);
+#endif /* __THREADPOOL_H__ */
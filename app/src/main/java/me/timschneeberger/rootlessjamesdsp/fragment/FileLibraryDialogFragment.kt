@@ -42,9 +42,11 @@ import me.timschneeberger.rootlessjamesdsp.utils.extensions.ContextExtensions.sh
 import me.timschneeberger.rootlessjamesdsp.utils.extensions.ContextExtensions.showInputAlert
 import me.timschneeberger.rootlessjamesdsp.utils.extensions.ContextExtensions.toast
 import me.timschneeberger.rootlessjamesdsp.utils.storage.StorageUtils
+import me.timschneeberger.rootlessjamesdsp.view.ProgressDialog
 import timber.log.Timber
 import java.io.File
 import java.util.Locale
+import java.util.concurrent.atomic.AtomicBoolean
 import kotlin.math.roundToInt
 
 
@@ -123,20 +125,14 @@ class FileLibraryDialogFragment : ListPreferenceDialogFragmentCompat(), TargetFr
             popupMenu.menu.findItem(R.id.edit_selection).isVisible = fileLibPreference.isLiveprog()
             popupMenu.menu.findItem(R.id.overwrite_selection).isVisible = fileLibPreference.isPreset()
             popupMenu.menu.findItem(R.id.resample_selection).isVisible = fileLibPreference.isIrs()
+            popupMenu.menu.findItem(R.id.resample_library).isVisible = fileLibPreference.isIrs()
 
             popupMenu.setOnMenuItemClickListener { menuItem ->
                 val selectedFile = File(path.toString())
                 when (menuItem.itemId) {
                     R.id.resample_selection -> {
                         if(fileLibPreference.isIrs()) {
-                            var targetRate = (requireActivity().application as MainApplication).engineSampleRate.roundToInt()
-                            if (targetRate <= 0) {
-                                targetRate = requireContext().getSystemService<AudioManager>()
-                                    ?.getProperty(AudioManager.PROPERTY_OUTPUT_SAMPLE_RATE)
-                                    ?.let { str -> Integer.parseInt(str).takeUnless { it == 0 } } ?: 48000
-                                Timber.w("resample: engine sample rate is zero, using HAL rate instead")
-                            }
-
+                            val targetRate = resampleTargetRate()
                             Timber.d("resample: Resampling ${selectedFile.name} to ${targetRate}Hz")
 
                             CoroutineScope(Dispatchers.IO).launch {
@@ -163,6 +159,14 @@ class FileLibraryDialogFragment : ListPreferenceDialogFragmentCompat(), TargetFr
                         }
                         refresh()
                     }
+                    R.id.resample_library -> {
+                        if(fileLibPreference.isIrs()) {
+                            val directory = selectedFile.absoluteFile.parentFile
+                                ?: return@setOnMenuItemClickListener true
+                            resampleLibrary(directory)
+                        }
+                        refresh()
+                    }
                     R.id.overwrite_selection -> {
                         if(fileLibPreference.isPreset()) {
                             if(Preset(selectedFile.name).save())
@@ -326,6 +330,69 @@ class FileLibraryDialogFragment : ListPreferenceDialogFragmentCompat(), TargetFr
         }
     }
 
+    private fun resampleLibrary(directory: File) {
+        val targetRate = resampleTargetRate()
+        val names = directory.list()?.filter {
+            File(it).extension.lowercase(Locale.ROOT) in arrayOf("wav", "irs", "flac", "mp3")
+        } ?: listOf()
+        // Skip outputs of earlier conversions: a "<rate>_" prefix with a known rate next to the unprefixed source
+        val files = names.filterNot { name ->
+            val (rate, source) = RESAMPLE_OUTPUT_PATTERN.matchEntire(name)?.destructured
+                ?: return@filterNot false
+            rate.toIntOrNull()?.let(RESAMPLE_OUTPUT_RATES::contains) == true && source in names
+        }.toTypedArray()
+        if(files.isEmpty())
+            return
+
+        Timber.d("resample: Resampling ${files.size} files to ${targetRate}Hz")
+
+        val cancelled = AtomicBoolean(false)
+        val progressDialog = ProgressDialog(requireContext()) {
+            cancelled.set(true)
+        }.apply {
+            title = getString(R.string.filelibrary_resample_library_ongoing, files.size, targetRate)
+            // Progress in files, with two decimals of resolution
+            maxProgress = files.size * 100
+            divisor = 100.0
+        }
+
+        CoroutineScope(Dispatchers.IO).launch {
+            val newNames = JdspImpResToolbox.OfflineAudioResampleLibrary(
+                directory.absolutePath + "/",
+                files,
+                targetRate
+            ) { progress ->
+                launch(Dispatchers.Main) {
+                    progressDialog.currentProgress = (progress * files.size * 100).roundToInt()
+                }
+                !cancelled.get()
+            }
+
+            withContext(Dispatchers.Main) {
+                progressDialog.dismiss()
+                try {
+                    requireContext().toast(getString(R.string.filelibrary_resample_library_complete,
+                        newNames.count { it != "Invalid" }, files.size, targetRate))
+                    refresh()
+                }
+                catch (_: IllegalStateException) {
+                    // Context may not be attached to fragment at this point
+                }
+            }
+        }
+    }
+
+    private fun resampleTargetRate(): Int {
+        var targetRate = (requireActivity().application as MainApplication).engineSampleRate.roundToInt()
+        if (targetRate <= 0) {
+            targetRate = requireContext().getSystemService<AudioManager>()
+                ?.getProperty(AudioManager.PROPERTY_OUTPUT_SAMPLE_RATE)
+                ?.let { str -> Integer.parseInt(str).takeUnless { it == 0 } } ?: 48000
+            Timber.w("resample: engine sample rate is zero, using HAL rate instead")
+        }
+        return targetRate
+    }
+
     private fun refresh() {
         fileLibPreference.refresh()
         dialog.listView.adapter = createAdapter()
@@ -546,6 +613,12 @@ class FileLibraryDialogFragment : ListPreferenceDialogFragmentCompat(), TargetFr
     companion object {
         private const val BUNDLE_KEY = "key"
 
+        private val RESAMPLE_OUTPUT_PATTERN = Regex("^(\\d+)_(.+)$")
+        // Rates the engine runs at, the only ones a conversion output can be prefixed with
+        private val RESAMPLE_OUTPUT_RATES = setOf(
+            8000, 11025, 16000, 22050, 24000, 32000, 44100, 48000, 64000, 88200, 96000, 176400, 192000, 352800, 384000
+        )
+
         fun newInstance(key: String): FileLibraryDialogFragment {
             val fragment = FileLibraryDialogFragment()
 
@@ -48,6 +48,9 @@ abstract class JamesDspBaseEngine(val context: Context, val callbacks: JamesDspW
             field = value
             reportSampleRate(value)
         }
+    // Rate the effect chain runs at; differs from sampleRate in fixed-rate mode
+    open val processingRate: Float
+        get() = sampleRate
 
     private val syncScope = CoroutineScope(Dispatchers.IO)
     private val syncMutex = Mutex()
@@ -435,7 +438,7 @@ abstract class JamesDspBaseEngine(val context: Context, val callbacks: JamesDspW
         val info = IntArray(4)
         val imp = JdspImpResToolbox.ReadImpulseResponseToFloat(
             path,
-            sampleRate.toInt(),
+            processingRate.toInt(),
             info,
             optimizationMode,
             advSetting
@@ -14,11 +14,74 @@ class JamesDspLocalEngine(context: Context, callbacks: JamesDspWrapper.JamesDspC
 
     override var sampleRate: Float
         set(value) {
+            val oldProcessingRate = processingRate
             super.sampleRate = value
             JamesDspWrapper.setSamplingRate(handle, value, true)
-            context.sendLocalBroadcast(Intent(Constants.ACTION_SAMPLE_RATE_UPDATED))
+            // In fixed-rate mode the chain keeps its rate, so the impulse response stays valid
+            if (processingRate != oldProcessingRate)
+                context.sendLocalBroadcast(Intent(Constants.ACTION_SAMPLE_RATE_UPDATED))
         }
         get() = super.sampleRate
+
+    // Internal rate of the effect chain, 0 follows the device rate
+    var fixedRate: Int = 0
+        set(value) {
+            val oldProcessingRate = processingRate
+            field = if (JamesDspWrapper.setFixedRateProcessing(handle, value)) value.coerceAtLeast(0) else 0
+            if (processingRate != oldProcessingRate)
+                context.sendLocalBroadcast(Intent(Constants.ACTION_SAMPLE_RATE_UPDATED))
+        }
+
+    // Largest sub-block the chain processes at once. Liveprog's @block runs per sub-block, so scripts see at most
+    // this many frames per call; 16384 restores whole-buffer calls for the buffer sizes the app offers
+    var processingBlockFrames: Int = 512
+        set(value) {
+            if (JamesDspWrapper.setProcessingBlockFrames(handle, value))
+                field = value
+        }
+
+    // Runs the libjamesdsp chain on its own thread, one block behind the FieldSurround and format stages
+    var pipelined: Boolean = false
+        set(value) {
+            field = JamesDspWrapper.setPipelinedProcessing(handle, value) && value
+        }
+
+    // Convolves in the wrapper with the long tail of the impulse response on background threads.
+    // The convolver then runs right after FieldSurround and ahead of the whole libjamesdsp chain, so
+    // the compressor, tube, reverb and limiter see the convolved signal.
+    var partitionedConvolution: Boolean = false
+        set(value) {
+            if (field == value)
+                return
+            field = JamesDspWrapper.setPartitionedConvolution(handle, value) && value
+            // Reloads the impulse response into whichever convolver is selected now
+            syncWithPreferences(arrayOf(Constants.PREF_CONVOLVER))
+        }
+
+    // Keeps the partitioned convolver's tail spectra in half precision, half the memory for a noise floor
+    // about 72 dB below the output
+    var halfPrecisionConvolution: Boolean = false
+        set(value) {
+            if (field == value)
+                return
+            field = JamesDspWrapper.setConvolverHalfPrecision(handle, value) && value
+            if (partitionedConvolution)
+                syncWithPreferences(arrayOf(Constants.PREF_CONVOLVER))
+        }
+
+    // Share of real time the partitioned convolver spends on the audio thread and on its workers, null while
+    // partitioned convolution is off or no impulse response is loaded
+    fun convolverLoad(): FloatArray? {
+        val load = FloatArray(2)
+        return if (JamesDspWrapper.getConvolverLoad(handle, load)) load else null
+    }
+
+    // Tail blocks the audio thread had to wait for
+    val convolverDeadlineMisses: Int
+        get() = JamesDspWrapper.getConvolverDeadlineMisses(handle)
+
+    override val processingRate: Float
+        get() = if (fixedRate > 0) fixedRate.toFloat() else super.sampleRate
     override var enabled: Boolean = true
 
     init {
@@ -284,6 +347,12 @@ class JamesDspLocalEngine(context: Context, callbacks: JamesDspWrapper.JamesDspC
         )
     }
 
+    // Whole-chain preview, see JamesDspWrapper.computeChainResponse
+    fun computeChainResponse(dispFreq: DoubleArray, magnitudeDb: FloatArray, phase: FloatArray): Boolean
+    {
+        return JamesDspWrapper.computeChainResponse(handle, dispFreq, magnitudeDb, phase)
+    }
+
     // Feature support
     override fun supportsEelVmAccess(): Boolean { return true }
     override fun supportsCustomCrossfeed(): Boolean { return true }
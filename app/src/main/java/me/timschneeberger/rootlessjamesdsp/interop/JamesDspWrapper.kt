@@ -25,6 +25,13 @@ object JamesDspWrapper {
 
     // Engine config
     external fun setSamplingRate(self: JamesDspHandle, sampleRate: Float, forceRefresh: Boolean)
+    external fun setFixedRateProcessing(self: JamesDspHandle, internalRate: Int): Boolean
+    external fun setProcessingBlockFrames(self: JamesDspHandle, frames: Int): Boolean
+    external fun setPipelinedProcessing(self: JamesDspHandle, enable: Boolean): Boolean
+    external fun setPartitionedConvolution(self: JamesDspHandle, enable: Boolean): Boolean
+    external fun setConvolverHalfPrecision(self: JamesDspHandle, enable: Boolean): Boolean
+    external fun getConvolverLoad(self: JamesDspHandle, load: FloatArray): Boolean
+    external fun getConvolverDeadlineMisses(self: JamesDspHandle): Int
 
     // Effect config
     external fun setLimiter(self: JamesDspHandle, threshold: Float, release: Float): Boolean
@@ -60,6 +67,8 @@ object JamesDspWrapper {
         stereoFloor: Float,
         stereoFallback: Float
     ): Boolean
+    // Linear response of the chain to a centered mono input, without the convolver; magnitudeDb and phase hold L then R, 2 * dispFreq.size values each
+    external fun computeChainResponse(self: JamesDspHandle, dispFreq: DoubleArray, magnitudeDb: FloatArray, phase: FloatArray): Boolean
     external fun setVacuumTube(self: JamesDspHandle, enable: Boolean, level: Float): Boolean
     external fun setSpectrumExtension(
         self: JamesDspHandle,
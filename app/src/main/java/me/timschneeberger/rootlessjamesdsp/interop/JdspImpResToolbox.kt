@@ -9,12 +9,37 @@ object JdspImpResToolbox {
         advParam: IntArray?
     ): FloatArray?
 
+    /**
+     * Impulse responses are cached per sample rate, switching back to a recent rate skips decoding.
+     * @param stats receives hits, misses, evictions, entries, bytes and budget
+     */
+    external fun GetCoefficientCacheStats(stats: LongArray)
+
+    /** Shrinking the budget evicts immediately, 0 disables the cache */
+    external fun SetCoefficientCacheBudget(budgetBytes: Int)
+
     external fun OfflineAudioResample(
         path: String,
         filename: String,
         targetSampleRate: Int
     ): String
 
+    fun interface ResampleProgressListener {
+        /** @return false to cancel the remaining conversions */
+        fun onProgress(progress: Float): Boolean
+    }
+
+    /**
+     * Converts several files of the same directory concurrently.
+     * @return output file name per input, "Invalid" for files that failed or were cancelled
+     */
+    external fun OfflineAudioResampleLibrary(
+        path: String,
+        filenames: Array<String>,
+        targetSampleRate: Int,
+        listener: ResampleProgressListener?
+    ): Array<String>
+
     external fun ComputeEqResponse(
         n: Int,
         freq: DoubleArray,
@@ -25,6 +50,22 @@ object JdspImpResToolbox {
         response: FloatArray
     ): Int
 
+    /**
+     * Evaluates several curves sharing the band frequencies in one call, e.g. preset thumbnails.
+     * @param gains freq.size gains per curve
+     * @param response queryPts values per curve
+     * @return 0 on success
+     */
+    external fun ComputeEqResponseBatch(
+        curves: Int,
+        freq: DoubleArray,
+        gains: DoubleArray,
+        interpolationMode: Int,
+        queryPts: Int,
+        dispFreq: DoubleArray,
+        response: FloatArray
+    ): Int
+
     external fun ComputeCompResponse(
         freq: DoubleArray,
         gain: DoubleArray,
@@ -144,6 +144,9 @@ class RootlessAudioProcessorService : BaseAudioProcessorService() {
         preferences.registerOnSharedPreferenceChangeListener(preferencesListener)
         loadFromPreferences(getString(R.string.key_powersave_suspend))
         loadFromPreferences(getString(R.string.key_session_exclude_restricted))
+        loadFromPreferences(getString(R.string.key_audioformat_fixed_rate))
+        loadFromPreferences(getString(R.string.key_audioformat_block_frames))
+        loadFromPreferences(getString(R.string.key_audioformat_pipelined))
 
         // Setup database observer
         blockedApps.observeForever(blockedAppObserver)
@@ -395,6 +398,18 @@ class RootlessAudioProcessorService : BaseAudioProcessorService() {
 
                 requestAudioRecordRecreation()
             }
+            getString(R.string.key_audioformat_fixed_rate) -> {
+                engine.fixedRate = preferences.get<String>(R.string.key_audioformat_fixed_rate).toIntOrNull() ?: 0
+                Timber.d("Fixed processing rate set to ${engine.fixedRate}")
+            }
+            getString(R.string.key_audioformat_block_frames) -> {
+                engine.processingBlockFrames = preferences.get<String>(R.string.key_audioformat_block_frames).toIntOrNull() ?: 512
+                Timber.d("Processing block size set to ${engine.processingBlockFrames}")
+            }
+            getString(R.string.key_audioformat_pipelined) -> {
+                engine.pipelined = preferences.get<Boolean>(R.string.key_audioformat_pipelined)
+                Timber.d("Pipelined processing set to ${engine.pipelined}")
+            }
         }
     }
 
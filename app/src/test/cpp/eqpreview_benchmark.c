@@ -0,0 +1,106 @@
+// Times the cached IIR and ViPER EQ preview responses of iirresponse.c, cold and with one band being dragged.
+// Usage: eqpreview_benchmark [iterations], prints microseconds per preview update at 512 and 2048 display points
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <time.h>
+#include "iirresponse.h"
+
+#define BANDS 15
+#define SHELF_ORDER 4
+#define SAMPLE_RATE 48000.0
+
+static const double bands[BANDS] = { 25.0, 40.0, 63.0, 100.0, 160.0, 250.0, 400.0, 630.0, 1000.0, 1600.0, 2500.0, 4000.0, 6300.0, 10000.0, 16000.0 };
+
+static double nowUs(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec * 1e-3;
+}
+
+// Same shelf layout as IIREqualizerPreviewCplx in JdspImpResToolbox.c
+static void shelfPreview(const double *gains, const double *dispFreq, int nPts, double *cplxRe, double *cplxIm)
+{
+	double designFreq[BANDS], dB[BANDS], overallGain[BANDS];
+	for (int i = 0; i < BANDS - 1; i++)
+	{
+		dB[i] = gains[i + 1] - gains[i];
+		designFreq[i] = i ? (bands[i + 1] + bands[i]) * 0.5 : bands[i];
+		overallGain[i] = i == 0 ? gains[i] : 0.0;
+	}
+	iirShelfCascadeResponse(SAMPLE_RATE, SHELF_ORDER, BANDS - 1, designFreq, dB, overallGain, dispFreq, nPts, cplxRe, cplxIm);
+}
+
+// One octave band-pass sections standing in for the ViPER band layout, only the band gains change between updates
+static void bankPreview(const double *sections, const double *gains, const double *dispFreq, int nPts, float *response)
+{
+	double bandGain[BANDS];
+	for (int i = 0; i < BANDS; i++)
+		bandGain[i] = pow(10.0, gains[i] / 20.0) * 0.636;
+	iirParallelBankResponse(SAMPLE_RATE, BANDS, sections, bandGain, dispFreq, nPts, response);
+}
+
+int main(int argc, char **argv)
+{
+	int iterations = argc > 1 ? atoi(argv[1]) : 200;
+	if (iterations <= 0)
+		iterations = 200;
+	double sections[BANDS * 5];
+	for (int i = 0; i < BANDS; i++)
+	{
+		double w0 = 2.0 * M_PI * bands[i] / SAMPLE_RATE;
+		double alpha = sin(w0) * sinh(log(2.0) * 0.5 * w0 / sin(w0));
+		double a0 = 1.0 + alpha;
+		sections[i * 5 + 0] = alpha / a0;
+		sections[i * 5 + 1] = 0.0;
+		sections[i * 5 + 2] = -alpha / a0;
+		sections[i * 5 + 3] = -2.0 * cos(w0) / a0;
+		sections[i * 5 + 4] = (1.0 - alpha) / a0;
+	}
+	static const int gridSizes[] = { 512, 2048 };
+	printf("points  iir_cold  iir_drag  viper_cold  viper_drag (us per update)\n");
+	for (size_t g = 0; g < sizeof(gridSizes) / sizeof(gridSizes[0]); g++)
+	{
+		int nPts = gridSizes[g];
+		double *dispFreq = (double*)malloc(nPts * sizeof(double));
+		double *cplxRe = (double*)malloc(nPts * sizeof(double));
+		double *cplxIm = (double*)malloc(nPts * sizeof(double));
+		float *response = (float*)malloc(nPts * sizeof(float));
+		if (!dispFreq || !cplxRe || !cplxIm || !response)
+			return 1;
+		for (int i = 0; i < nPts; i++)
+			dispFreq[i] = 20.0 * pow(22000.0 / 20.0, (double)i / (nPts > 1 ? nPts - 1 : 1));
+		double gains[BANDS];
+		for (int i = 0; i < BANDS; i++)
+			gains[i] = 6.0 * sin(i * 0.7);
+		double results[4];
+		for (int pass = 0; pass < 4; pass++)
+		{
+			int viper = pass >= 2, drag = pass & 1;
+			iirResponseCacheClear();
+			double t0 = 0.0;
+			for (int it = -1; it < iterations; it++)
+			{
+				// The untimed first round warms the caches of the drag passes
+				if (it == 0)
+					t0 = nowUs();
+				if (drag)
+					gains[7] = (it & 1) ? 3.0 : -3.0;
+				else
+					iirResponseCacheClear();
+				if (viper)
+					bankPreview(sections, gains, dispFreq, nPts, response);
+				else
+					shelfPreview(gains, dispFreq, nPts, cplxRe, cplxIm);
+			}
+			results[pass] = (nowUs() - t0) / iterations;
+		}
+		printf("%6d  %8.1f  %8.1f  %10.1f  %10.1f\n", nPts, results[0], results[1], results[2], results[3]);
+		free(dispFreq);
+		free(cplxRe);
+		free(cplxIm);
+		free(response);
+	}
+	return 0;
+}
@@ -0,0 +1,216 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <float.h>
+#include "iranalysis.h"
+
+static int failures = 0;
+#define CHECK(cond, ...) \
+	do { if (!(cond)) { failures++; fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); fprintf(stderr, __VA_ARGS__); fputc('\n', stderr); } } while (0)
+
+// Two-pass scalar trimming as the toolbox did it before the analysis module, with the peak taken as an
+// absolute value
+static void referenceStartEnd(float **signal, int channels, int nsamples, float cutoff1, float cutoff2, int range[2])
+{
+	float max = fabsf(signal[0][0]);
+	for (int i = 0; i < channels; i++)
+		for (int j = 1; j < nsamples; j++)
+			if (fabsf(signal[i][j]) > max)
+				max = fabsf(signal[i][j]);
+	max = 1.0f / ((max < FLT_EPSILON) ? (max + FLT_EPSILON) : max);
+	float linGain1 = powf(10.0f, cutoff1 / 20.0f);
+	float linGain2 = powf(10.0f, cutoff2 / 20.0f);
+	int lastSmps = 0;
+	int firstSmpsPrevious = nsamples - 1;
+	int lastSmpsPrevious = 0;
+	for (int i = 0; i < channels; i++)
+	{
+		int found = 0;
+		int firstSmps = 0;
+		for (int j = 0; j < nsamples; j++)
+		{
+			float normalized = fabsf(signal[i][j]) * max;
+			if (!found && normalized > linGain1 && !firstSmps)
+			{
+				firstSmps = j;
+				found = 1;
+			}
+			if (normalized > linGain2)
+				lastSmps = j;
+		}
+		firstSmpsPrevious = firstSmpsPrevious < firstSmps ? firstSmpsPrevious : firstSmps;
+		lastSmpsPrevious = lastSmpsPrevious > lastSmps ? lastSmpsPrevious : lastSmps;
+	}
+	range[0] = firstSmpsPrevious != (nsamples - 1) ? firstSmpsPrevious : 0;
+	range[1] = lastSmpsPrevious + 1;
+}
+// Bitwise CRC-32 over the interleaved words, 8 rounds per word
+static int32_t referenceJoinCrc(float **signal, unsigned int channels, float *out, unsigned int frames)
+{
+	union
+	{
+		int32_t raw;
+		float f;
+	} fltInt;
+	int32_t crc = 0xFFFFFFFF;
+	for (unsigned int i = 0; i < frames * channels; i++)
+	{
+		out[i] = signal[i % channels][i / channels];
+		fltInt.f = out[i];
+		crc ^= fltInt.raw;
+		for (int j = 7; j >= 0; j--)
+		{
+			int32_t mask = -(crc & 1);
+			crc = (crc >> 1) ^ (0xEDB88320 & mask);
+		}
+	}
+	return ~crc;
+}
+
+static unsigned int rngState = 12345u;
+static float noise(void)
+{
+	rngState = rngState * 1664525u + 1013904223u;
+	return (float)(rngState >> 8) / 8388608.0f - 1.0f;
+}
+// Exponentially decaying noise after a pre-delay, a different delay and decay per channel
+static float **syntheticIr(int channels, int frames, int preDelay, float decayFrames, float gain)
+{
+	float **x = (float**)malloc(channels * sizeof(float*));
+	for (int c = 0; c < channels; c++)
+	{
+		x[c] = (float*)calloc(frames, sizeof(float));
+		for (int i = preDelay + c * 7; i < frames; i++)
+			x[c][i] = gain * noise() * expf(-(float)(i - preDelay) / (decayFrames * (1.0f + 0.3f * c)));
+	}
+	return x;
+}
+static void freeIr(float **x, int channels)
+{
+	for (int c = 0; c < channels; c++)
+		free(x[c]);
+	free(x);
+}
+
+static void checkAgainstReference(const char *name, float **x, int channels, int frames)
+{
+	irAnalysis ir;
+	CHECK(!analyseImpulseResponse(&ir, x, channels, frames), "%s: analysis failed", name);
+
+	// Peak: absolute maximum, first occurrence
+	float peak = 0.0f;
+	int peakChannel = 0, peakIndex = 0;
+	for (int c = 0; c < channels; c++)
+		for (int i = 0; i < frames; i++)
+			if (fabsf(x[c][i]) > peak)
+			{
+				peak = fabsf(x[c][i]);
+				peakChannel = c;
+				peakIndex = i;
+			}
+	CHECK(ir.peak == peak, "%s: peak %g, expected %g", name, ir.peak, peak);
+	CHECK(ir.peakChannel == peakChannel && ir.peakIndex == peakIndex, "%s: peak at %d/%d, expected %d/%d",
+		name, ir.peakChannel, ir.peakIndex, peakChannel, peakIndex);
+
+	// Energy is summed per block in float, so allow float rounding relative to the total
+	for (int c = 0; c < channels; c++)
+	{
+		double energy = 0.0;
+		for (int i = 0; i < frames; i++)
+			energy += (double)x[c][i] * x[c][i];
+		CHECK(fabs(ir.energy[c] - energy) <= 1e-5 * energy + 1e-12, "%s: channel %d energy %.9g, expected %.9g",
+			name, c, ir.energy[c], energy);
+	}
+
+	// Trimming must match the reference exactly for every cutoff pair the app offers
+	static const float cutoffs[][2] = { { -80.0f, -100.0f }, { -40.0f, -60.0f }, { -6.0f, -20.0f }, { -0.1f, -0.1f } };
+	for (size_t k = 0; k < sizeof(cutoffs) / sizeof(cutoffs[0]); k++)
+	{
+		int expected[2], range[2];
+		referenceStartEnd(x, channels, frames, cutoffs[k][0], cutoffs[k][1], expected);
+		irAnalysisTrimRange(&ir, x, cutoffs[k][0], cutoffs[k][1], range);
+		CHECK(range[0] == expected[0] && range[1] == expected[1], "%s: cutoff %g/%g range [%d, %d), expected [%d, %d)",
+			name, cutoffs[k][0], cutoffs[k][1], range[0], range[1], expected[0], expected[1]);
+	}
+	freeIrAnalysis(&ir);
+
+	// Checksum and interleaving are bit exact
+	float *out = (float*)malloc((size_t)frames * channels * sizeof(float));
+	float *expectedOut = (float*)malloc((size_t)frames * channels * sizeof(float));
+	int32_t crc = irJoinInterleavedCrc(x, channels, out, frames);
+	int32_t expectedCrc = referenceJoinCrc(x, channels, expectedOut, frames);
+	CHECK(crc == expectedCrc, "%s: crc %08x, expected %08x", name, (unsigned)crc, (unsigned)expectedCrc);
+	CHECK(!memcmp(out, expectedOut, (size_t)frames * channels * sizeof(float)), "%s: interleaved output differs", name);
+	free(out);
+	free(expectedOut);
+}
+
+static void testSyntheticIrs(void)
+{
+	static const int layouts[] = { 1, 2, 4 };
+	// Lengths around the block size and a few seconds of 48 kHz
+	static const int lengths[] = { 1, 63, 64, 65, 1000, 48000, 144001 };
+	for (size_t l = 0; l < sizeof(layouts) / sizeof(layouts[0]); l++)
+		for (size_t n = 0; n < sizeof(lengths) / sizeof(lengths[0]); n++)
+		{
+			char name[64];
+			const int frames = lengths[n];
+			snprintf(name, sizeof(name), "%d ch, %d frames", layouts[l], frames);
+			float **x = syntheticIr(layouts[l], frames, frames / 10, frames / 8.0f + 1.0f, 0.8f);
+			checkAgainstReference(name, x, layouts[l], frames);
+			freeIr(x, layouts[l]);
+		}
+}
+
+// The old scan kept the signed sample, a negative peak made the normalization negative
+static void testNegativePeak(void)
+{
+	float **x = syntheticIr(2, 5000, 300, 800.0f, 0.25f);
+	x[1][1234] = -0.95f;
+	checkAgainstReference("negative peak", x, 2, 5000);
+	freeIr(x, 2);
+}
+
+static void testPeakInLastPartialBlock(void)
+{
+	float **x = syntheticIr(1, 1000, 0, 100.0f, 0.1f);
+	x[0][999] = 1.0f;
+	checkAgainstReference("peak in last block", x, 1, 1000);
+	freeIr(x, 1);
+}
+
+// A block of NaNs never compares equal to the peak, the index scan has to stay inside the peak block
+static void testNanBlock(void)
+{
+	const int frames = 256;
+	float *x = (float*)calloc(frames, sizeof(float));
+	for (int i = 64; i < 128; i++)
+		x[i] = NAN;
+	irAnalysis ir;
+	CHECK(!analyseImpulseResponse(&ir, &x, 1, frames), "nan: analysis failed");
+	CHECK(ir.peakIndex >= 0 && ir.peakIndex < frames, "nan: peak index %d outside the signal", ir.peakIndex);
+	freeIrAnalysis(&ir);
+	free(x);
+}
+
+static void testSilence(void)
+{
+	float *x = (float*)calloc(100, sizeof(float));
+	checkAgainstReference("silence", &x, 1, 100);
+	free(x);
+}
+
+int main(void)
+{
+	testSyntheticIrs();
+	testNegativePeak();
+	testPeakInLastPartialBlock();
+	testNanBlock();
+	testSilence();
+	if (failures)
+		fprintf(stderr, "%d check(s) failed\n", failures);
+	else
+		printf("iranalysis: all checks passed\n");
+	return failures ? 1 : 0;
+}
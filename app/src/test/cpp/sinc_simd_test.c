@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <float.h>
+// Included rather than linked so every kernel table compiled for this target is reachable, not only the one
+// the running CPU selects
+#include "src_sinc_simd.c"
+
+static int failures = 0;
+#define CHECK(cond, ...) \
+	do { if (!(cond)) { failures++; fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); fprintf(stderr, __VA_ARGS__); fputc('\n', stderr); } } while (0)
+
+#define MAX_TAPS 4096
+
+static unsigned int rngState = 777u;
+static double uniform(void)
+{
+	rngState = rngState * 1664525u + 1013904223u;
+	return (double)(rngState >> 8) / 8388608.0 - 1.0;
+}
+
+// Reordering a double accumulation of taps products changes it by at most about taps * eps times the sum of
+// the absolute products. A factor of two on top leaves room for the final pairwise adds.
+static double tolerance(const double *coeff, const float *data, int taps, int channels, int c)
+{
+	double sumAbs = 0.0;
+	for (int k = 0; k < taps; k++)
+		sumAbs += fabs(coeff[k] * data[k * channels + c]);
+	return 2.0 * (taps + 4) * DBL_EPSILON * sumAbs;
+}
+
+static void checkKernel(const char *impl, const char *layout, sinc_dot_func kernel, sinc_dot_func reference,
+	int channels, const double *coeff, const float *data, int taps)
+{
+	// Kernels add to the accumulator, start both from the same nonzero value
+	double acc[4], expected[4];
+	for (int c = 0; c < 4; c++)
+		acc[c] = expected[c] = 0.25 * (c + 1);
+	kernel(coeff, data, taps, acc);
+	reference(coeff, data, taps, expected);
+	for (int c = 0; c < channels; c++)
+	{
+		const double bound = tolerance(coeff, data, taps, channels, c);
+		CHECK(fabs(acc[c] - expected[c]) <= bound, "%s %s, %d taps, channel %d: %.17g vs scalar %.17g (bound %.3g)",
+			impl, layout, taps, c, acc[c], expected[c], bound);
+		// The converter stores float samples, those must come out bit identical or one ulp apart at most
+		const float a = (float)acc[c], b = (float)expected[c];
+		CHECK(a == b || nextafterf(a, b) == b, "%s %s, %d taps, channel %d: float output %.9g vs %.9g",
+			impl, layout, taps, c, a, b);
+	}
+	// Channels the layout does not cover stay untouched
+	for (int c = channels; c < 4; c++)
+		CHECK(acc[c] == 0.25 * (c + 1), "%s %s: wrote accumulator %d", impl, layout, c);
+}
+
+static void checkFuncs(const SINC_DOT_FUNCS *funcs)
+{
+	const SINC_DOT_FUNCS *scalar = sinc_dot_funcs_scalar();
+	double *coeff = (double*)malloc(MAX_TAPS * sizeof(double));
+	float *data = (float*)malloc(MAX_TAPS * 4 * sizeof(float));
+	// Every remainder of the unrolled loops, then lengths the converter actually uses per filter half
+	static const int taps[] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 15, 16, 17, 31, 33, 255, 1023, 2047, 2048, 4095, 4096 };
+	for (size_t t = 0; t < sizeof(taps) / sizeof(taps[0]); t++)
+	{
+		for (int k = 0; k < taps[t]; k++)
+		{
+			// Sinc-like coefficient envelope and full-scale input
+			const double x = (double)k / (taps[t] + 1);
+			coeff[k] = uniform() * (1.0 - x) * (1.0 - x);
+		}
+		for (int k = 0; k < taps[t] * 4; k++)
+			data[k] = (float)uniform();
+		checkKernel(funcs->name, "mono", funcs->mono, scalar->mono, 1, coeff, data, taps[t]);
+		checkKernel(funcs->name, "stereo", funcs->stereo, scalar->stereo, 2, coeff, data, taps[t]);
+		checkKernel(funcs->name, "quad", funcs->quad, scalar->quad, 4, coeff, data, taps[t]);
+	}
+	free(coeff);
+	free(data);
+}
+
+int main(void)
+{
+	int tested = 0;
+#if defined(SINC_SIMD_X86)
+	checkFuncs(&sse2_funcs);
+	tested++;
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx"))
+	{
+		checkFuncs(&avx_funcs);
+		tested++;
+	}
+	else
+		printf("sinc_simd: CPU without AVX, AVX kernels not tested\n");
+#elif defined(SINC_SIMD_NEON)
+	checkFuncs(&neon_funcs);
+	tested++;
+#endif
+	// Whatever the converter picks at runtime is one of the tables above or the scalar code itself
+	checkFuncs(sinc_dot_funcs());
+	if (failures)
+		fprintf(stderr, "%d check(s) failed\n", failures);
+	else
+		printf("sinc_simd: %d vector implementation(s) match the scalar kernels, runtime choice %s\n", tested, sinc_dot_funcs()->name);
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,236 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "stereobiquad/StereoBiquad.h"
+
+using stereobiquad::Coefficients;
+using stereobiquad::StereoBiquad;
+
+static int failures = 0;
+#define CHECK(cond, ...) \
+    do { if (!(cond)) { failures++; std::fprintf(stderr, "%s:%d: ", __FILE__, __LINE__); std::fprintf(stderr, __VA_ARGS__); std::fputc('\n', stderr); } } while (0)
+
+static constexpr double PI = 3.14159265358979323846;
+
+// Transposed direct form II in double, one sample at a time, as the per-channel filters did before the
+// stereo engine
+struct ReferenceBiquad {
+    Coefficients c;
+    double s1 = 0.0;
+    double s2 = 0.0;
+
+    double process(double x) {
+        const double y = c.b0 * x + s1;
+        s1 = c.b1 * x - c.a1 * y + s2;
+        s2 = c.b2 * x - c.a2 * y;
+        return y;
+    }
+};
+
+// RBJ cookbook sections, normalized to a0 = 1
+static Coefficients normalize(double b0, double b1, double b2, double a0, double a1, double a2) {
+    Coefficients c;
+    c.b0 = b0 / a0;
+    c.b1 = b1 / a0;
+    c.b2 = b2 / a0;
+    c.a1 = a1 / a0;
+    c.a2 = a2 / a0;
+    return c;
+}
+static Coefficients highPass(double fc, double fs, double q) {
+    const double w = 2.0 * PI * fc / fs, alpha = std::sin(w) / (2.0 * q), cw = std::cos(w);
+    return normalize((1.0 + cw) / 2.0, -(1.0 + cw), (1.0 + cw) / 2.0, 1.0 + alpha, -2.0 * cw, 1.0 - alpha);
+}
+static Coefficients highShelf(double fc, double fs, double gainDb, double q) {
+    const double a = std::pow(10.0, gainDb / 40.0), w = 2.0 * PI * fc / fs;
+    const double alpha = std::sin(w) / (2.0 * q), cw = std::cos(w), sa = 2.0 * std::sqrt(a) * alpha;
+    return normalize(a * ((a + 1.0) + (a - 1.0) * cw + sa), -2.0 * a * ((a - 1.0) + (a + 1.0) * cw),
+                     a * ((a + 1.0) + (a - 1.0) * cw - sa), (a + 1.0) - (a - 1.0) * cw + sa,
+                     2.0 * ((a - 1.0) - (a + 1.0) * cw), (a + 1.0) - (a - 1.0) * cw - sa);
+}
+static Coefficients peaking(double fc, double fs, double gainDb, double q) {
+    const double a = std::pow(10.0, gainDb / 40.0), w = 2.0 * PI * fc / fs;
+    const double alpha = std::sin(w) / (2.0 * q), cw = std::cos(w);
+    return normalize(1.0 + alpha * a, -2.0 * cw, 1.0 - alpha * a, 1.0 + alpha / a, -2.0 * cw, 1.0 - alpha / a);
+}
+
+static uint32_t rngState = 4242u;
+static float noise() {
+    rngState = rngState * 1664525u + 1013904223u;
+    return static_cast<float>(rngState >> 8) / 8388608.0f - 1.0f;
+}
+// Full-scale white noise on the left, a decaying sine on the right
+static std::vector<float> stereoSignal(uint32_t frames, double fs) {
+    std::vector<float> x(static_cast<size_t>(frames) * 2);
+    for (uint32_t i = 0; i < frames; ++i) {
+        x[i * 2] = noise();
+        x[i * 2 + 1] = static_cast<float>(0.9 * std::sin(2.0 * PI * 997.0 * i / fs) * std::exp(-static_cast<double>(i) / frames));
+    }
+    return x;
+}
+
+template <size_t Sections>
+static double maxError(const std::vector<float>& actual, const std::vector<float>& input, const Coefficients (&c)[Sections]) {
+    double worst = 0.0;
+    for (int ch = 0; ch < 2; ++ch) {
+        ReferenceBiquad ref[Sections];
+        for (size_t s = 0; s < Sections; ++s) {
+            ref[s].c = c[s];
+        }
+        for (size_t i = 0; i < input.size() / 2; ++i) {
+            double y = input[i * 2 + ch];
+            for (size_t s = 0; s < Sections; ++s) {
+                y = ref[s].process(y);
+            }
+            worst = std::max(worst, std::fabs(actual[i * 2 + ch] - y));
+        }
+    }
+    return worst;
+}
+
+// Steady coefficients: the stereo engine stays within a fixed absolute error of the double reference on a
+// full-scale signal. Float sections are held to 1e-4 (-80 dBFS), the double lane only adds the final
+// rounding to float.
+template <typename Real, size_t Sections>
+static void checkStatic(const char* name, const Coefficients (&c)[Sections], double fs, double bound) {
+    StereoBiquad<Real, Sections> filter;
+    for (size_t s = 0; s < Sections; ++s) {
+        filter.setCoefficients(s, c[s]);
+    }
+    const std::vector<float> input = stereoSignal(1u << 16, fs);
+    std::vector<float> output(input);
+    // Odd block sizes so the block edges land everywhere
+    for (size_t offset = 0, block = 1; offset < output.size() / 2; offset += block, block = block * 3 % 1021 + 1) {
+        const auto frames = static_cast<uint32_t>(std::min(block, output.size() / 2 - offset));
+        filter.process(output.data() + offset * 2, frames);
+    }
+    const double error = maxError(output, input, c);
+    CHECK(error <= bound, "%s: max error %.3g exceeds %.3g", name, error, bound);
+    std::printf("%-44s max error %.3g (bound %.3g)\n", name, error, bound);
+}
+
+// Interleaved, planar and mono entry points run the same kernel and must agree bit for bit
+static void checkLayoutsAgree() {
+    const Coefficients c = highShelf(4000.0, 48000.0, 6.0, 0.7);
+    StereoBiquad<float> interleaved, planar, mono;
+    interleaved.setCoefficients(0, c);
+    planar.setCoefficients(0, c);
+    mono.setCoefficients(0, c);
+    const std::vector<float> input = stereoSignal(4096, 48000.0);
+    std::vector<float> a(input), left(4096), right(4096), m(4096);
+    for (uint32_t i = 0; i < 4096; ++i) {
+        left[i] = input[i * 2];
+        right[i] = input[i * 2 + 1];
+        m[i] = input[i * 2];
+    }
+    interleaved.process(a.data(), 4096);
+    planar.processPlanar(left.data(), right.data(), 4096);
+    mono.processMono(m.data(), m.data(), 4096);
+    bool same = true;
+    for (uint32_t i = 0; i < 4096; ++i) {
+        same = same && a[i * 2] == left[i] && a[i * 2 + 1] == right[i] && a[i * 2] == m[i];
+    }
+    CHECK(same, "layouts: interleaved, planar and mono outputs differ");
+}
+
+// Ramp: the coefficients move linearly from the old to the new set, one step before each of rampFrames
+// frames, with the state kept. The reference ramps in double with exactly that schedule. After the ramp the
+// filter sits exactly on the target.
+template <typename Real>
+static void checkRamp(const char* name, const Coefficients& from, const Coefficients& to, uint32_t rampFrames,
+                      double fs, double bound) {
+    StereoBiquad<Real> filter;
+    filter.setCoefficients(0, from);
+    const uint32_t frames = 3 * rampFrames + 4096;
+    const std::vector<float> input = stereoSignal(frames, fs);
+    std::vector<float> output(input);
+    // Settle on the old coefficients, then ramp across several uneven blocks
+    const uint32_t start = 1000;
+    filter.process(output.data(), start);
+    filter.setCoefficients(0, to, rampFrames);
+    for (uint32_t offset = start, block = 7; offset < frames; offset += block, block = block * 5 % 613 + 1) {
+        filter.process(output.data() + offset * 2, std::min(block, frames - offset));
+    }
+
+    double worst = 0.0, worstAfter = 0.0;
+    for (int ch = 0; ch < 2; ++ch) {
+        ReferenceBiquad ref;
+        ref.c = from;
+        for (uint32_t i = 0; i < frames; ++i) {
+            if (i >= start && i < start + rampFrames) {
+                const double t = static_cast<double>(i - start + 1) / rampFrames;
+                ref.c.b0 = from.b0 + (to.b0 - from.b0) * t;
+                ref.c.b1 = from.b1 + (to.b1 - from.b1) * t;
+                ref.c.b2 = from.b2 + (to.b2 - from.b2) * t;
+                ref.c.a1 = from.a1 + (to.a1 - from.a1) * t;
+                ref.c.a2 = from.a2 + (to.a2 - from.a2) * t;
+            } else if (i >= start + rampFrames) {
+                ref.c = to;
+            }
+            const double error = std::fabs(output[i * 2 + ch] - ref.process(input[i * 2 + ch]));
+            worst = std::max(worst, error);
+            if (i >= start + rampFrames + 2048) {
+                worstAfter = std::max(worstAfter, error);
+            }
+        }
+    }
+    CHECK(worst <= bound, "%s: max error %.3g during the ramp exceeds %.3g", name, worst, bound);
+    // Once the ramp has landed and its rounding has decayed, the filter is as close as a steady one
+    CHECK(worstAfter <= bound, "%s: max error %.3g after the ramp exceeds %.3g", name, worstAfter, bound);
+    CHECK(filter.coefficients(0) == to, "%s: target coefficients not kept", name);
+    std::printf("%-44s max error %.3g (bound %.3g)\n", name, worst, bound);
+}
+
+// A ramp restarted before the first one finished still lands on the latest target
+static void checkRampRestart() {
+    const double fs = 48000.0;
+    const Coefficients a = highShelf(2000.0, fs, -6.0, 0.7), b = highShelf(6000.0, fs, 9.0, 0.7), c = highShelf(3000.0, fs, 0.0, 0.7);
+    StereoBiquad<float> filter, settled;
+    filter.setCoefficients(0, a);
+    filter.setCoefficients(0, b, 256);
+    std::vector<float> x = stereoSignal(8192, fs);
+    filter.process(x.data(), 100);
+    filter.setCoefficients(0, c, 256);
+    filter.process(x.data() + 200, 8092);
+    settled.setCoefficients(0, c);
+    // Compare the steady state with a filter that always had the final coefficients on the same input
+    std::vector<float> y = stereoSignal(4096, fs), z(y);
+    filter.reset();
+    filter.process(y.data(), 4096);
+    settled.process(z.data(), 4096);
+    CHECK(std::memcmp(y.data(), z.data(), y.size() * sizeof(float)) == 0, "restart: filter did not land on the last target");
+}
+
+int main() {
+    const double fs = 48000.0;
+    // Clarity OZONE shelf and XHIFI-like peaking section in float
+    const Coefficients shelf[1] = {highShelf(8000.0, fs, 12.0, 0.7)};
+    checkStatic<float>("float high shelf 8 kHz +12 dB", shelf, fs, 1e-4);
+    const Coefficients cascade[2] = {peaking(300.0, fs, -4.0, 1.0), highShelf(6000.0, fs, 6.0, 0.7)};
+    checkStatic<float>("float two-section cascade", cascade, fs, 1e-4);
+    // FieldSurround depth high-pass in double, including the lowest cutoff at the highest rate
+    const Coefficients hp[1] = {highPass(800.0, fs, 0.72)};
+    checkStatic<double>("double high-pass 800 Hz", hp, fs, 1.5e-7);
+    const Coefficients lowHp[1] = {highPass(20.0, 192000.0, 0.72)};
+    checkStatic<double>("double high-pass 20 Hz at 192 kHz", lowHp, 192000.0, 1.5e-7);
+
+    checkLayoutsAgree();
+
+    checkRamp<float>("float shelf ramp over 256 frames", highShelf(2000.0, fs, -6.0, 0.7),
+                     highShelf(6000.0, fs, 9.0, 0.7), 256, fs, 1e-4);
+    checkRamp<double>("double high-pass ramp over 256 frames", highPass(200.0, fs, 0.72),
+                      highPass(1200.0, fs, 0.72), 256, fs, 1.5e-7);
+    checkRamp<double>("double high-pass ramp at 192 kHz", highPass(20.0, 192000.0, 0.72),
+                      highPass(800.0, 192000.0, 0.72), 256, 192000.0, 1.5e-7);
+    checkRampRestart();
+
+    if (failures) {
+        std::fprintf(stderr, "%d check(s) failed\n", failures);
+    } else {
+        std::printf("stereobiquad: all checks passed\n");
+    }
+    return failures ? 1 : 0;
+}